@@ -0,0 +1,693 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "erow.h"
+#include "kilo.h"
+#include "slab.h"
+#include "undo.h"
+#include "utils.h"
+
+// Randomized tests of the row and buffer edit primitives against a plain
+// model, then timings of each. make check runs the tests alone, make bench
+// both.
+
+struct editor_state E;
+
+// The rest of what the primitives link against lives with main
+char *error_message;
+
+void error_set_message(const char *prefix) {
+    (void) prefix;
+}
+
+bool editor_tick(void) {
+    return false;
+}
+
+void editor_set_message(const char *fmt, ...) {
+    (void) fmt;
+}
+
+// Allocations made anywhere in the editor are counted, the link wraps them
+// where the linker can
+static size_t n_heap, n_slab;
+
+#ifdef BENCH_COUNT_ALLOCS
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_slab_alloc(struct slab *slab, size_t size);
+void *__real_slab_realloc(struct slab *slab, void *ptr, size_t old_size, size_t new_size);
+
+void *__wrap_malloc(size_t size) {
+    n_heap++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    n_heap++;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    n_heap++;
+    return __real_realloc(ptr, size);
+}
+
+void *__wrap_slab_alloc(struct slab *slab, size_t size) {
+    n_slab++;
+    return __real_slab_alloc(slab, size);
+}
+
+void *__wrap_slab_realloc(struct slab *slab, void *ptr, size_t old_size, size_t new_size) {
+    n_slab++;
+    return __real_slab_realloc(slab, ptr, old_size, new_size);
+}
+#endif
+
+static uint64_t rng_state;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static size_t rng_below(size_t n) {
+    return n ? rng_next() % n : 0;
+}
+
+// Short text, heavy on tabs so that they land at every column
+static void rng_text(char *chars, size_t n_chars) {
+    static const char alphabet[] = "ab \t\tx_9";
+
+    for (size_t i = 0; i < n_chars; i++)
+        chars[i] = alphabet[rng_below(sizeof(alphabet) - 1)];
+}
+
+/*****************************************************************************/
+
+static int n_failures;
+
+#define CHECK(cond, ...) do {                                               \
+    if (!(cond)) {                                                          \
+        fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);          \
+        fprintf(stderr, __VA_ARGS__);                                       \
+        fputc('\n', stderr);                                                \
+        n_failures++;                                                       \
+        return;                                                             \
+    }                                                                       \
+} while (0)
+
+// The model of a row is its text, everything else is worked out from that
+// the slow way
+struct model_row {
+    char *chars;
+    size_t n_chars;
+};
+
+static int model_width(const struct model_row *row, size_t cx, int rx) {
+    return row->chars[cx] == '\t' ? KILO_TAB_STOP - rx % KILO_TAB_STOP : 1;
+}
+
+static void model_insert(struct model_row *row, const char *chars, size_t n_chars, size_t at) {
+    row->chars = realloc(row->chars, row->n_chars + n_chars + 1);
+    memmove(row->chars + at + n_chars, row->chars + at, row->n_chars - at);
+    memcpy(row->chars + at, chars, n_chars);
+    row->n_chars += n_chars;
+}
+
+static void model_delete(struct model_row *row, size_t n_chars, size_t at) {
+    memmove(row->chars + at, row->chars + at + n_chars, row->n_chars - at - n_chars);
+    row->n_chars -= n_chars;
+}
+
+static void check_row(struct erow *erow, const struct model_row *row, const char *context) {
+    CHECK(erow->n_chars == row->n_chars, "%s: %zu chars, expected %zu",
+          context, erow->n_chars, row->n_chars);
+    CHECK(row->n_chars == 0 || memcmp(erow->chars, row->chars, row->n_chars) == 0,
+          "%s: chars differ", context);
+
+    int rx = 0;
+    for (size_t cx = 0; cx <= row->n_chars; cx++) {
+        CHECK(erow_cx_to_rx(erow, cx) == rx, "%s: cx %zu is rx %d, expected %d",
+              context, cx, erow_cx_to_rx(erow, cx), rx);
+        CHECK(erow_rx_to_cx(erow, rx) == (int) cx, "%s: rx %d is cx %d, expected %zu",
+              context, rx, erow_rx_to_cx(erow, rx), cx);
+
+        if (cx == row->n_chars)
+            break;
+
+        // Every column a tab takes up maps back to the tab
+        int width = model_width(row, cx, rx);
+        for (int i = 0; i < width; i++) {
+            CHECK(erow->rchars[rx + i] == (row->chars[cx] == '\t' ? ' ' : row->chars[cx]),
+                  "%s: rchars differ at rx %d", context, rx + i);
+            CHECK(erow_rx_to_cx(erow, rx + i) == (int) cx, "%s: rx %d is cx %d, expected %zu",
+                  context, rx + i, erow_rx_to_cx(erow, rx + i), cx);
+        }
+
+        rx += width;
+    }
+
+    CHECK(erow->n_rchars == (size_t) rx, "%s: %zu rchars, expected %d", context, erow->n_rchars, rx);
+    CHECK(erow_rx_to_cx(erow, rx + 7) == (int) row->n_chars, "%s: rx past the end is cx %d",
+          context, erow_rx_to_cx(erow, rx + 7));
+}
+
+// Random inserts and deletes on one row, alone or in a buffer
+static void check_erow(bool in_buffer) {
+    struct buffer *buffer = in_buffer ? buffer_create() : NULL;
+
+    for (int round = 0; round < 500; round++) {
+        char chars[64];
+        struct model_row row = { malloc(64), rng_below(40) };
+        rng_text(row.chars, row.n_chars);
+
+        struct erow *erow = erow_create(row.chars, row.n_chars, buffer);
+        if (buffer) buffer_insert_row(buffer, erow, buffer->n_rows);
+
+        char context[64];
+        for (int step = 0; step < 50 && n_failures == 0; step++) {
+            size_t at = rng_below(row.n_chars + 1);
+
+            if (rng_below(2)) {
+                size_t n_chars = rng_below(8) + 1;
+                rng_text(chars, n_chars);
+
+                erow_insert_chars(erow, chars, n_chars, at);
+                model_insert(&row, chars, n_chars, at);
+            } else {
+                size_t n_chars = rng_below(row.n_chars - at + 1);
+
+                erow_delete_chars(erow, n_chars, at);
+                model_delete(&row, n_chars, at);
+            }
+
+            snprintf(context, sizeof(context), "erow round %d step %d", round, step);
+            check_row(erow, &row, context);
+        }
+
+        if (!buffer) erow_free(erow);
+        free(row.chars);
+    }
+
+    if (buffer) buffer_free(buffer);
+}
+
+static void check_rows(struct buffer *buffer, struct model_row *rows, int n_rows, const char *context) {
+    CHECK(buffer->n_rows == n_rows, "%s: %d rows, expected %d", context, buffer->n_rows, n_rows);
+
+    size_t n_expected = 0;
+    for (int i = 0; i < n_rows; i++) {
+        check_row(buffer_get_row(buffer, i), &rows[i], context);
+        n_expected += rows[i].n_chars + 1;
+    }
+
+    size_t n_chars;
+    char *chars = buffer_get_string(buffer, &n_chars);
+
+    CHECK(n_chars == n_expected, "%s: %zu chars in all, expected %zu", context, n_chars, n_expected);
+    for (int i = 0, j = 0; i < n_rows; j += rows[i++].n_chars + 1) {
+        CHECK(memcmp(chars + j, rows[i].chars, rows[i].n_chars) == 0 && chars[j + rows[i].n_chars] == '\n',
+              "%s: row %d differs in the string", context, i);
+    }
+
+    free(chars);
+}
+
+// Random row inserts, deletes and edits on a buffer read in the way the
+// options given would have it, shared or compressed. The mark has to stay on
+// the line it was set on, or go with it.
+static void check_buffer(const char *name, bool intern, int cold_rows) {
+    E.intern = intern;
+    E.cold_rows = cold_rows;
+
+    int n_rows = rng_below(200) + 1, rows_cap = 1024;
+    struct model_row *rows = malloc(rows_cap * sizeof(struct model_row));
+
+    // A few distinct lines, so that sharing has something to share
+    FILE *file = tmpfile();
+    for (int i = 0; i < n_rows; i++) {
+        rows[i].n_chars = rng_below(4) * 5;
+        rows[i].chars = malloc(rows[i].n_chars + 1);
+        memset(rows[i].chars, 'a' + rng_below(3), rows[i].n_chars);
+        if (rows[i].n_chars) rows[i].chars[0] = '\t';
+
+        fwrite(rows[i].chars, 1, rows[i].n_chars, file);
+        fputc('\n', file);
+    }
+    fflush(file);
+    rewind(file);
+
+    struct buffer *buffer = buffer_create();
+    buffer_read_fd(buffer, dup(fileno(file)));
+    buffer_poll_load(buffer, true);
+    fclose(file);
+
+    char context[64], chars[64];
+    snprintf(context, sizeof(context), "%s buffer as read", name);
+    check_rows(buffer, rows, n_rows, context);
+
+    int mark = -1;
+    for (int step = 0; step < 2000 && n_failures == 0; step++) {
+        if (mark == -1 && n_rows && rng_below(8) == 0)
+            buffer->mark = mark = rng_below(n_rows);
+
+        int at = rng_below(n_rows + 1), op = rng_below(5);
+        if (n_rows == rows_cap) op = 1, at = MIN(at, n_rows - 1);
+        else if (at == n_rows) op = 0;
+
+        if (op == 0) {
+            struct model_row row = { malloc(16), rng_below(16) };
+            rng_text(row.chars, row.n_chars);
+
+            buffer_insert_row(buffer, erow_create(row.chars, row.n_chars, buffer), at);
+            memmove(rows + at + 1, rows + at, (n_rows - at) * sizeof(struct model_row));
+            rows[at] = row;
+            n_rows++;
+
+            if (mark >= at) mark++;
+        } else if (op == 1) {
+            buffer_delete_row(buffer, at);
+            free(rows[at].chars);
+            memmove(rows + at, rows + at + 1, (n_rows - at - 1) * sizeof(struct model_row));
+            n_rows--;
+
+            if (mark == at) mark = -1;
+            else if (mark > at) mark--;
+        } else if (op == 2) {
+            size_t n_chars = rng_below(8) + 1, to = rng_below(rows[at].n_chars + 1);
+            rng_text(chars, n_chars);
+
+            erow_insert_chars(buffer_edit_row(buffer, at), chars, n_chars, to);
+            model_insert(&rows[at], chars, n_chars, to);
+        } else if (op == 4) {
+            int n_old = rng_below(MIN(n_rows - at, 3) + 1), n_new = MIN((int) rng_below(4), n_old + rows_cap - n_rows);
+
+            struct erow *new_rows[3];
+            for (int i = 0; i < n_old; i++)
+                free(rows[at + i].chars);
+            memmove(rows + at + n_new, rows + at + n_old, (n_rows - at - n_old) * sizeof(struct model_row));
+
+            for (int i = 0; i < n_new; i++) {
+                rows[at + i] = (struct model_row) { malloc(16), rng_below(16) };
+                rng_text(rows[at + i].chars, rows[at + i].n_chars);
+                new_rows[i] = erow_create(rows[at + i].chars, rows[at + i].n_chars, buffer);
+            }
+
+            buffer_replace_rows(buffer, at, n_old, new_rows, n_new);
+            n_rows += n_new - n_old;
+
+            if (at <= mark && mark < at + n_old) mark = -1;
+            else if (mark >= at + n_old) mark += n_new - n_old;
+        } else {
+            size_t to = rng_below(rows[at].n_chars + 1), n_chars = rng_below(rows[at].n_chars - to + 1);
+
+            erow_delete_chars(buffer_edit_row(buffer, at), n_chars, to);
+            model_delete(&rows[at], n_chars, to);
+        }
+
+        snprintf(context, sizeof(context), "%s buffer step %d", name, step);
+        check_rows(buffer, rows, n_rows, context);
+        CHECK(buffer->mark == mark, "%s: mark at %d, expected %d", context, buffer->mark, mark);
+    }
+
+    for (int i = 0; i < n_rows; i++)
+        free(rows[i].chars);
+    free(rows);
+    buffer_free(buffer);
+
+    E.intern = false;
+    E.cold_rows = 0;
+}
+
+static struct model_row *model_copy(const struct model_row *rows, int n_rows) {
+    struct model_row *copy = malloc(MAX(n_rows, 1) * sizeof(struct model_row));
+
+    for (int i = 0; i < n_rows; i++) {
+        copy[i] = (struct model_row) { malloc(rows[i].n_chars + 1), rows[i].n_chars };
+        memcpy(copy[i].chars, rows[i].chars, rows[i].n_chars);
+    }
+
+    return copy;
+}
+
+// Steps of rows replaced, swapped in place, reordered and cut, as the line
+// commands make them, have to be undone all the way back and redone all the
+// way forward again, going through the same text at every step
+static void check_undo(void) {
+    enum { N_STEPS = 100, MAX_OPS = 3, MAX_SPAN = 20, MAX_ROWS = 100 + N_STEPS * MAX_OPS * MAX_SPAN };
+
+    struct model_row *rows = malloc(MAX_ROWS * sizeof(struct model_row));
+    struct model_row *states[N_STEPS + 1];
+    int n_states_rows[N_STEPS + 1];
+
+    struct buffer *buffer = buffer_create();
+    int n_rows = rng_below(100) + 1;
+    for (int i = 0; i < n_rows; i++) {
+        rows[i] = (struct model_row) { malloc(16), rng_below(16) };
+        rng_text(rows[i].chars, rows[i].n_chars);
+        buffer_insert_row(buffer, erow_create(rows[i].chars, rows[i].n_chars, buffer), i);
+    }
+
+    undo_clear(buffer->undo);
+    states[0] = model_copy(rows, n_rows);
+    n_states_rows[0] = n_rows;
+
+    char context[64];
+    for (int step = 1; step <= N_STEPS; step++) {
+        undo_seal(buffer->undo, 0, 0);
+
+        for (int n_ops = rng_below(MAX_OPS) + 1; n_ops > 0; n_ops--) {
+            int at = rng_below(n_rows + 1), n_old = rng_below(MIN(n_rows - at, MAX_SPAN) + 1), op = rng_below(4);
+
+            // Every op has to change something, or its step would be empty
+            if (n_old == 0)
+                op = 0;
+
+            if (op == 0) {
+                int n_new = rng_below(MAX_SPAN) + (n_old == 0);
+
+                struct erow *new_rows[MAX_SPAN];
+                for (int i = 0; i < n_old; i++)
+                    free(rows[at + i].chars);
+                memmove(rows + at + n_new, rows + at + n_old, (n_rows - at - n_old) * sizeof(struct model_row));
+
+                for (int i = 0; i < n_new; i++) {
+                    rows[at + i] = (struct model_row) { malloc(16), rng_below(16) };
+                    rng_text(rows[at + i].chars, rows[at + i].n_chars);
+                    new_rows[i] = erow_create(rows[at + i].chars, rows[at + i].n_chars, buffer);
+                }
+
+                buffer_replace_rows(buffer, at, n_old, new_rows, n_new);
+                n_rows += n_new - n_old;
+            } else if (op == 1) {
+                int ats[MAX_SPAN];
+                struct erow *new_rows[MAX_SPAN];
+                for (int i = 0; i < n_old; i++) {
+                    ats[i] = at + i;
+                    rows[at + i].n_chars = rng_below(16);
+                    rng_text(rows[at + i].chars, rows[at + i].n_chars);
+                    new_rows[i] = erow_create(rows[at + i].chars, rows[at + i].n_chars, buffer);
+                }
+
+                buffer_swap_rows(buffer, ats, new_rows, n_old);
+            } else if (op == 2) {
+                struct erow *reversed[MAX_SPAN];
+                for (int i = 0; i < n_old; i++)
+                    reversed[i] = buffer_get_row(buffer, at + n_old - 1 - i);
+
+                buffer_reorder_rows(buffer, at, n_old, reversed, n_old);
+                for (int i = 0, j = n_old - 1; i < j; i++, j--) {
+                    struct model_row row = rows[at + i];
+                    rows[at + i] = rows[at + j];
+                    rows[at + j] = row;
+                }
+            } else if (op == 3) {
+                struct erow *cut[MAX_SPAN];
+                for (int i = 0; i < n_old; i++) {
+                    cut[i] = buffer_get_row(buffer, at + i);
+                    free(rows[at + i].chars);
+                }
+
+                buffer_reorder_rows(buffer, at, n_old, NULL, 0);
+                for (int i = 0; i < n_old; i++)
+                    erow_free(cut[i]);
+
+                memmove(rows + at, rows + at + n_old, (n_rows - at - n_old) * sizeof(struct model_row));
+                n_rows -= n_old;
+            }
+        }
+
+        states[step] = model_copy(rows, n_rows);
+        n_states_rows[step] = n_rows;
+    }
+
+    for (int step = N_STEPS - 1; step >= 0 && n_failures == 0; step--) {
+        CHECK(undo_step_back(buffer->undo, buffer) == 0, "undo step %d failed", step + 1);
+        snprintf(context, sizeof(context), "undo back to step %d", step);
+        check_rows(buffer, states[step], n_states_rows[step], context);
+    }
+
+    for (int step = 1; step <= N_STEPS && n_failures == 0; step++) {
+        CHECK(undo_step_forward(buffer->undo, buffer) == 0, "redo step %d failed", step);
+        snprintf(context, sizeof(context), "redo to step %d", step);
+        check_rows(buffer, states[step], n_states_rows[step], context);
+    }
+
+    for (int step = 0; step <= N_STEPS; step++) {
+        for (int i = 0; i < n_states_rows[step]; i++)
+            free(states[step][i].chars);
+        free(states[step]);
+    }
+
+    for (int i = 0; i < n_rows; i++)
+        free(rows[i].chars);
+    free(rows);
+    buffer_free(buffer);
+}
+
+static void check_all(void) {
+    check_erow(false);
+    check_erow(true);
+    check_buffer("plain", false, 0);
+    check_buffer("shared", true, 0);
+    check_buffer("compressed", false, 8);
+    check_undo();
+}
+
+/*****************************************************************************/
+
+// Each benchmark times op over runs of n_batch calls, with setup preparing
+// each run and teardown cleaning up after it, both left out of the timing
+struct bench {
+    const char *name;
+    int n_batch;
+
+    void (*setup)(void);
+    void (*op)(int i);
+    void (*teardown)(void);
+};
+
+#define BENCH_BATCH 16
+#define BENCH_TIME_NS (100 * 1000 * 1000L)
+
+// What the benchmarks work on. Lines look like code, a tab every so often.
+static struct {
+    struct buffer *buffer;
+    struct erow *erow;
+    struct erow *rows[BENCH_BATCH];
+
+    char *line;
+    size_t n_line;
+    int at;
+} bench;
+
+static void bench_make_line(size_t n_line) {
+    static const char code[] = "\tif (erow->n_chars > at) count += erow_update(erow, at);";
+
+    bench.line = realloc(bench.line, n_line + BENCH_BATCH);
+    for (size_t i = 0; i < n_line + BENCH_BATCH; i++)
+        bench.line[i] = code[i % (sizeof(code) - 1)];
+    bench.n_line = n_line;
+}
+
+static void bench_row_setup(void) {
+    bench.erow = erow_create(bench.line, bench.n_line, bench.buffer);
+    buffer_insert_row(bench.buffer, bench.erow, 0);
+}
+
+// Deletes start off longer, to end up where inserts start
+static void bench_long_row_setup(void) {
+    bench.erow = erow_create(bench.line, bench.n_line + BENCH_BATCH, bench.buffer);
+    buffer_insert_row(bench.buffer, bench.erow, 0);
+}
+
+static void bench_row_teardown(void) {
+    buffer_delete_row(bench.buffer, 0);
+}
+
+static void bench_create(int i) {
+    bench.rows[i] = erow_create(bench.line, bench.n_line, bench.buffer);
+}
+
+static void bench_create_teardown(void) {
+    for (int i = 0; i < BENCH_BATCH; i++)
+        erow_free(bench.rows[i]);
+}
+
+static void bench_insert_chars(int i) {
+    (void) i;
+    erow_insert_chars(bench.erow, "x", 1, bench.erow->n_chars / 2);
+}
+
+static void bench_delete_chars(int i) {
+    (void) i;
+    erow_delete_chars(bench.erow, 1, bench.erow->n_chars / 2);
+}
+
+static void bench_cx_to_rx(int i) {
+    (void) i;
+    bench.at += erow_cx_to_rx(bench.erow, bench.erow->n_chars);
+}
+
+static void bench_rx_to_cx(int i) {
+    (void) i;
+    bench.at += erow_rx_to_cx(bench.erow, bench.erow->n_rchars);
+}
+
+static void bench_new_rows_setup(void) {
+    for (int i = 0; i < BENCH_BATCH; i++)
+        bench.rows[i] = erow_create(bench.line, bench.n_line, bench.buffer);
+}
+
+static void bench_insert_row(int i) {
+    buffer_insert_row(bench.buffer, bench.rows[i], bench.buffer->n_rows / 2);
+}
+
+static void bench_insert_row_teardown(void) {
+    for (int i = 0; i < BENCH_BATCH; i++)
+        buffer_delete_row(bench.buffer, bench.buffer->n_rows / 2);
+}
+
+static void bench_delete_row_setup(void) {
+    bench_new_rows_setup();
+    for (int i = 0; i < BENCH_BATCH; i++)
+        buffer_insert_row(bench.buffer, bench.rows[i], bench.buffer->n_rows / 2);
+}
+
+static void bench_delete_row(int i) {
+    (void) i;
+    buffer_delete_row(bench.buffer, bench.buffer->n_rows / 2);
+}
+
+static void bench_get_string(int i) {
+    (void) i;
+    size_t n_chars;
+    free(buffer_get_string(bench.buffer, &n_chars));
+}
+
+static long bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+// Runs batches until they add up to BENCH_TIME_NS, or the setups take too long
+static void bench_run(const struct bench *b, const char *param) {
+    long elapsed = 0, n_ops = 0, started = bench_now();
+    size_t heap = 0, slab = 0;
+
+    while (elapsed < BENCH_TIME_NS && bench_now() - started < 10 * BENCH_TIME_NS) {
+        if (b->setup) b->setup();
+
+        size_t heap_before = n_heap, slab_before = n_slab;
+        long start = bench_now();
+
+        for (int i = 0; i < b->n_batch; i++)
+            b->op(i);
+
+        elapsed += bench_now() - start;
+        heap += n_heap - heap_before;
+        slab += n_slab - slab_before;
+        n_ops += b->n_batch;
+
+        if (b->teardown) b->teardown();
+    }
+
+#ifdef BENCH_COUNT_ALLOCS
+    printf("%-20s %-12s %12.1f ns/op %8.2f allocs/op %8.2f slab/op\n", b->name, param,
+           (double) elapsed / n_ops, (double) heap / n_ops, (double) slab / n_ops);
+#else
+    (void) heap, (void) slab;
+    printf("%-20s %-12s %12.1f ns/op\n", b->name, param, (double) elapsed / n_ops);
+#endif
+}
+
+static void bench_all(void) {
+    const struct bench row_benches[] = {
+        { "erow_create", BENCH_BATCH, NULL, bench_create, bench_create_teardown },
+        { "erow_insert_chars", BENCH_BATCH, bench_row_setup, bench_insert_chars, bench_row_teardown },
+        { "erow_delete_chars", BENCH_BATCH, bench_long_row_setup, bench_delete_chars, bench_row_teardown },
+        { "erow_cx_to_rx", BENCH_BATCH, bench_row_setup, bench_cx_to_rx, bench_row_teardown },
+        { "erow_rx_to_cx", BENCH_BATCH, bench_row_setup, bench_rx_to_cx, bench_row_teardown },
+    };
+
+    const struct bench buffer_benches[] = {
+        { "buffer_insert_row", BENCH_BATCH, bench_new_rows_setup, bench_insert_row,
+          bench_insert_row_teardown },
+        { "buffer_delete_row", BENCH_BATCH, bench_delete_row_setup, bench_delete_row, NULL },
+        { "buffer_get_string", 1, NULL, bench_get_string, NULL },
+    };
+
+    const size_t line_lens[] = { 16, 80, 1024, 16384 };
+    const int buffer_sizes[] = { 1000, 100000, 1000000 };
+    char param[32];
+
+    bench.buffer = buffer_create();
+
+    for (size_t i = 0; i < sizeof(row_benches) / sizeof(row_benches[0]); i++) {
+        for (size_t j = 0; j < sizeof(line_lens) / sizeof(line_lens[0]); j++) {
+            bench_make_line(line_lens[j]);
+            snprintf(param, sizeof(param), "%zu chars", line_lens[j]);
+            bench_run(&row_benches[i], param);
+        }
+    }
+
+    // Rows of 40 chars, the buffer grown to each size in turn
+    bench_make_line(40);
+
+    for (size_t j = 0; j < sizeof(buffer_sizes) / sizeof(buffer_sizes[0]); j++) {
+        while (bench.buffer->n_rows < buffer_sizes[j]) {
+            struct erow *erow = erow_create(bench.line, bench.n_line, bench.buffer);
+            buffer_insert_row(bench.buffer, erow, bench.buffer->n_rows);
+        }
+
+        snprintf(param, sizeof(param), "%d rows", buffer_sizes[j]);
+        for (size_t i = 0; i < sizeof(buffer_benches) / sizeof(buffer_benches[0]); i++)
+            bench_run(&buffer_benches[i], param);
+    }
+
+    buffer_free(bench.buffer);
+    free(bench.line);
+}
+
+int main(int argc, char **argv) {
+    E.mem_limit = KILO_DEFAULT_MEM_LIMIT;
+    E.undo_limit = KILO_DEFAULT_UNDO_LIMIT;
+
+    // bench [-t] [SEED], -t to leave out the timings
+    bool tests_only = false;
+    rng_state = time(NULL);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) tests_only = true;
+        else rng_state = strtoull(argv[i], NULL, 10);
+    }
+
+    if (rng_state == 0) rng_state = 1;
+
+    printf("seed %llu\n", (unsigned long long) rng_state);
+    check_all();
+
+    if (n_failures) {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    printf("ok\n");
+
+    if (!tests_only)
+        bench_all();
+
+    return 0;
+}
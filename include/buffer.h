@@ -3,10 +3,47 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 
 #include "utils.h"
 
+struct cold;
 struct erow;
+struct intern;
+struct journal;
+struct loader;
+struct pager;
+struct slab;
+struct syntax;
+struct undo;
+struct watch;
+struct words;
+
+enum file_event {
+    FILE_UNCHANGED,
+    FILE_APPENDED,
+    FILE_CHANGED,
+};
+
+enum edit_type {
+    EDIT_INSERT_CHARS,
+    EDIT_DELETE_CHARS,
+    EDIT_INSERT_ROW,
+    EDIT_DELETE_ROW,
+};
+
+// One call to an edit primitive. chars is the text inserted, or about to be
+// deleted, in row.
+struct edit {
+    enum edit_type type;
+    int row;
+    size_t at;
+
+    const char *chars;
+    size_t n_chars;
+};
+
 struct buffer {
     char *filename;
 
@@ -14,18 +51,85 @@ struct buffer {
     int row_off, col_off;
 
     struct erow **rows;
-    int n_rows;
+    int n_rows, rows_cap;
+
+    // Allocations of rows since the buffer was created, the rows' own are
+    // counted by the slab, see stats.h. Growing it in place is counted apart.
+    size_t n_table_allocs, n_table_frees, n_table_reallocs;
+
+    // Every row and its text is carved out of this, see slab.h
+    struct slab *slab;
+
+    // Non-NULL while rows are still being read in the background
+    struct loader *loader;
+
+    // Non-NULL for files too big to hold as rows, rows is unused then
+    struct pager *pager;
+
+    // Non-NULL when rows away from the screen are kept compressed, or when
+    // identical rows share their text
+    struct cold *cold;
+    struct intern *intern;
+
+    // Every word in the rows, for completion, see words.h. NULL when paged.
+    struct words *words;
+
+    // How much of the file has been read in, and whether its last line was
+    // missing a newline, so that whatever gets appended can be picked up
+    struct watch *watch;
+    off_t file_size;
+    bool tail_partial, merge_tail;
+    bool follow, stale;
+
+    // The file as it was when last read or written. disk_changed is set when
+    // it was changed by someone else while the buffer had unsaved edits.
+    struct stat file_stat;
+    bool disk_changed;
+
+    // Rows before hl_from are highlighted and up to date, see syntax.h
+    const struct syntax *syntax;
+    int hl_from;
+
+    // Created on the first edit after a load or save, see journal.h. Edits
+    // made while untracked is set are passed on neither to it nor to undo.
+    struct undo *undo;
+    struct journal *journal;
+    bool journal_failed, untracked;
+    int edit_hint;
+
+    // Transactions currently open, see buffer_begin
+    int n_open;
+
+    // Row set with CTRL-B to mark a range up to the cursor, -1 if none
+    int mark;
 
     bool modified;
 };
 
 struct buffer *buffer_create(void);
 ERRCODE buffer_read_file(struct buffer *buffer, const char *filename);
+void buffer_read_fd(struct buffer *buffer, int fd);
+bool buffer_poll_load(struct buffer *buffer, bool wait);
+bool buffer_is_loading(struct buffer *buffer);
+void buffer_unload(struct buffer *buffer);
+size_t buffer_mem_used(struct buffer *buffer);
+enum file_event buffer_poll_file(struct buffer *buffer);
+ERRCODE buffer_reload_file(struct buffer *buffer, int *n_changed, int *n_hunks);
 ERRCODE buffer_write_file(struct buffer *buffer, size_t *bytes_written);
-void buffer_insert_row(struct buffer *buffer, struct erow *erow, int at);
-void buffer_delete_row(struct buffer *buffer, int at);
+bool buffer_insert_row(struct buffer *buffer, struct erow *erow, int at);
+bool buffer_delete_row(struct buffer *buffer, int at);
+bool buffer_replace_rows(struct buffer *buffer, int at, int n_old, struct erow **rows, int n_new);
+void buffer_reorder_rows(struct buffer *buffer, int at, int n_old, struct erow **rows, int n_new);
+void buffer_swap_rows(struct buffer *buffer, const int *ats, struct erow **rows, int n_rows);
+struct erow *buffer_get_row(struct buffer *buffer, int at);
+struct erow *buffer_edit_row(struct buffer *buffer, int at);
 struct erow *buffer_get_crow(struct buffer *buffer);
+char *buffer_get_string(struct buffer *buffer, size_t *n_chars);
+void buffer_track_row_edit(struct buffer *buffer, struct erow *erow, enum edit_type type, size_t at,
+                           const char *chars, size_t n_chars);
 size_t buffer_get_crow_len(struct buffer *buffer);
+void buffer_begin(struct buffer *buffer);
+void buffer_commit(struct buffer *buffer, int cx, int cy);
 void buffer_free(struct buffer *buffer);
 
 #endif // BUFFER_H
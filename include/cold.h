@@ -0,0 +1,60 @@
+#ifndef COLD_H
+#define COLD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Rows can be kept compressed while nobody looks at them. The loader packs
+// rows into blocks and stores only each block's compressed text, leaving the
+// rows' chars NULL. Looking a row up thaws its block, and once more blocks
+// are thawed than the hot window needs, the least recently used one is frozen
+// again. Rows about to be edited are copied out of their block for good.
+#define COLD_BLOCK_ROWS 256
+#define COLD_BLOCK_BYTES (64 * 1024)
+
+struct buffer;
+struct erow;
+struct slab;
+
+struct cold_block {
+    // Rows in the order of the text, NULL where one has left the block
+    struct erow **rows;
+    int n_rows, n_live;
+
+    // The text of every row followed by a newline, compressed
+    char *data;
+    size_t n_data, n_raw;
+
+    // Only while thawed, the rows' chars and rchars point into these
+    char *raw, *render;
+    size_t last_used;
+
+    int at, thawed_at;
+};
+
+struct cold {
+    struct cold_block **blocks;
+    int n_blocks, blocks_cap;
+
+    struct cold_block **thawed;
+    int n_thawed, max_thawed;
+
+    size_t clock;
+    size_t n_hits, n_misses;
+    size_t n_bytes_raw, n_bytes_data;
+};
+
+struct cold *cold_create(int hot_rows);
+struct cold_block *cold_block_create(void);
+struct erow *cold_block_add(struct cold_block *block, struct slab *slab, const char *chars, size_t n_chars,
+                            struct buffer *buffer);
+bool cold_block_full(struct cold_block *block);
+void cold_block_seal(struct cold_block *block);
+void cold_block_free(struct cold_block *block);
+void cold_add(struct cold *cold, struct cold_block *block);
+void cold_touch(struct cold *cold, struct erow *erow);
+void cold_adopt(struct cold *cold, struct erow *erow, struct slab *slab);
+void cold_detach(struct cold *cold, struct erow *erow);
+void cold_free(struct cold *cold);
+
+#endif // COLD_H
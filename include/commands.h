@@ -8,6 +8,23 @@ void command_move_cursor(KEY key);
 void command_insert_line(void);
 void command_insert_char(char c);
 void command_delete_char(void);
+void command_delete_next_char(void);
 void command_save_buffer(void);
+void command_reload_buffer(void);
+void command_undo(void);
+void command_redo(void);
+void command_toggle_follow(void);
+void command_record_macro(void);
+void command_replay_macro(void);
+void command_set_mark(void);
+void command_filter(void);
+void command_reorder(void);
+void command_replace(void);
+void command_complete(void);
+void command_cut(void);
+void command_copy(void);
+void command_paste(void);
+void command_next_buffer(void);
+void command_stats(void);
 
 #endif // COMMANDS_H
@@ -3,5 +3,7 @@
 
 struct buffer;
 void cursor_move(struct buffer *buffer, int dx, int dy);
+void cursor_set(struct buffer *buffer, int cx, int cy);
+void cursor_place(struct buffer *buffer, int cx, int cy);
 
 #endif // CURSOR_H
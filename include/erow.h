@@ -1,9 +1,13 @@
 #ifndef EROW_H
 #define EROW_H
 
+#include <stdbool.h>
 #include <stdlib.h>
 
 struct buffer;
+struct cold_block;
+struct intern_line;
+struct slab;
 
 struct erow {
     char *chars;
@@ -12,14 +16,28 @@ struct erow {
     char *rchars;
     size_t n_rchars;
 
+    // One highlight per rendered char, see syntax.h
+    unsigned char *hl;
+    int hl_in, hl_out;
+    bool hl_stale;
+
+    // Non-NULL while the text is kept in a compressed block, see cold.h
+    struct cold_block *cold;
+
+    // Non-NULL while the text is shared with identical rows, see intern.h
+    struct intern_line *shared;
+
     struct buffer *buffer;
 };
 
 struct erow *erow_create(const char* chars, size_t n_chars, struct buffer *buffer);
+struct erow *erow_create_in(struct slab *slab, const char* chars, size_t n_chars, struct buffer *buffer);
+struct erow *erow_create_shared(struct slab *slab, struct intern_line *line, struct buffer *buffer);
 void erow_insert_chars(struct erow *erow, const char *chars, size_t n_chars, int at);
 void erow_delete_chars(struct erow *erow, size_t n_chars, int at);
 int erow_cx_to_rx(struct erow *erow, int cx);
 int erow_rx_to_cx(struct erow *erow, int rx);
+size_t erow_render(const char *chars, size_t n_chars, char *rchars);
 void erow_free(struct erow *erow);
 
 #endif // EROW_H
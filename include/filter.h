@@ -0,0 +1,12 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "utils.h"
+
+struct buffer;
+struct erow;
+
+ERRCODE filter_run(struct buffer *buffer, int from, int to, const char *command,
+                   struct erow ***rows, int *n_rows, int *status);
+
+#endif // FILTER_H
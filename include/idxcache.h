@@ -0,0 +1,14 @@
+#ifndef IDXCACHE_H
+#define IDXCACHE_H
+
+#include "utils.h"
+
+// The page index of a paged file is kept under $XDG_CACHE_HOME/kilo, keyed
+// by the file's path, size, mtime and inode, so that reopening an unchanged
+// file does not have to scan it for newlines again.
+struct pager;
+
+ERRCODE idxcache_load(const char *filename, struct pager *pager);
+ERRCODE idxcache_store(const char *filename, struct pager *pager);
+
+#endif // IDXCACHE_H
@@ -0,0 +1,44 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Identical lines can share their text. Each distinct line is kept once, as
+// an immutable intern_line counted by the rows showing it, and a row about to
+// be edited gets its own copy first. The loader shares lines within a batch,
+// the buffer's store then shares them across batches as they come in.
+struct erow;
+struct slab;
+
+struct intern_line {
+    char *chars, *rchars;
+    size_t n_chars, n_rchars;
+
+    uint32_t hash;
+    int refs;
+
+    // Chains a bucket. A line from a batch that turned out to be in the
+    // buffer's store already is forwarded to that one through here instead.
+    struct intern_line *next;
+    bool stored, forwarded;
+};
+
+struct intern {
+    struct intern_line **buckets;
+    size_t n_buckets, n_lines;
+
+    // What the rows would take beyond this if each had its own copy
+    size_t n_bytes_saved;
+};
+
+struct intern *intern_create(void);
+struct intern_line *intern_get(struct intern *intern, struct slab *slab, const char *chars, size_t n_chars);
+void intern_adopt(struct intern *intern, struct erow **rows, int n_rows, struct slab *slab);
+struct intern_line *intern_share(struct intern *intern, struct erow *erow, struct slab *slab);
+void intern_release(struct intern *intern, struct intern_line *line, struct slab *slab);
+void intern_clear(struct intern *intern);
+void intern_free(struct intern *intern);
+
+#endif // INTERN_H
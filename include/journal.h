@@ -0,0 +1,23 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <sys/stat.h>
+
+#include "utils.h"
+
+// Unsaved edits are appended to .<name>.kilo-swap next to the file, one
+// compact record per edit primitive, and synced in groups rather than on
+// every keystroke. The header pins down the file the edits apply to.
+struct buffer;
+struct edit;
+struct journal;
+
+struct journal *journal_open(const char *filename, const struct stat *file_stat);
+void journal_record(struct journal *journal, const struct edit *edit);
+void journal_flush(struct journal *journal);
+void journal_discard(struct journal *journal);
+bool journal_found(const char *filename);
+ERRCODE journal_recover(struct buffer *buffer, int *n_edits);
+
+#endif // JOURNAL_H
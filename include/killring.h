@@ -0,0 +1,30 @@
+#ifndef KILLRING_H
+#define KILLRING_H
+
+// Lines cut or copied, newest first. Cut rows are kept as they were, and
+// pasting makes rows sharing their text, see intern_share, so moving lines
+// around never copies them unless one of the copies is edited. Rows taken
+// from a buffer that is about to drop its rows get copies of their own.
+#define KILLRING_SIZE 8
+
+struct buffer;
+struct erow;
+
+struct kill {
+    struct erow **rows;
+    int n_rows;
+};
+
+struct killring {
+    struct kill kills[KILLRING_SIZE];
+    int newest, n_kills;
+};
+
+struct killring *killring_create(void);
+void killring_push(struct killring *ring, struct erow **rows, int n_rows);
+struct erow *killring_clone(struct erow *erow, struct buffer *buffer);
+struct erow **killring_paste(struct killring *ring, int age, struct buffer *buffer, int *n_rows);
+void killring_release(struct killring *ring, struct buffer *buffer);
+void killring_free(struct killring *ring);
+
+#endif // KILLRING_H
@@ -2,15 +2,49 @@
 #define KILO_H
 
 #define KILO_TAB_STOP 4
+#define KILO_DEFAULT_MEM_LIMIT ((size_t) 1024 * 1024 * 1024)
+#define KILO_DEFAULT_UNDO_LIMIT ((size_t) 64 * 1024 * 1024)
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <termios.h>
 #include <time.h>
 
+#include "input.h"
+
+// A file given on the command line. Its rows are read in when first switched
+// to, or before that while idle, and dropped again if memory runs short
+// while it is not being looked at.
+struct editor_buffer {
+    struct buffer *buffer;
+    bool loaded, fetched;
+
+    // When it was last switched to, 0 if never
+    long last_used;
+
+    // What its rows took when they were last dropped, 0 if never
+    size_t mem_dropped;
+};
+
 struct editor_state {
     int screenrows, screencols;
     int quit_times;
+    KEY last_key;
+
+    size_t mem_limit, undo_limit;
+    int cold_rows;
+    bool force_paged, index_cache, follow, intern;
 
     struct buffer *current_buf;
+    struct editor_buffer *buffers;
+    int n_buffers, buffer_at;
+    long n_switches;
+    struct macro *macro;
+    struct killring *kill_ring;
+
+    // Where keys are read and the screen drawn. Standard in, unless data
+    // is being piped in through it.
+    int tty_fd;
     struct termios orig_termios;
 
     char message[256];
@@ -18,8 +52,10 @@ struct editor_state {
 };
 extern struct editor_state E;
 
+bool editor_tick(void);
+void editor_switch_buffer(int at);
 void editor_set_message(const char *fmt, ...);
-char *editor_prompt(const char *prompt);
+char *editor_prompt(const char *prompt, bool allow_empty);
 
 extern char *error_message;
 void error_set_message(const char *prefix);
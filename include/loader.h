@@ -0,0 +1,45 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+struct buffer;
+struct cold_block;
+struct erow;
+struct page_extent;
+struct slab;
+struct words;
+
+// Rows are built off the main thread in batches. Each batch carries the slab
+// its rows were allocated from, to be merged into the buffer's on publish,
+// and for compressed buffers the blocks holding their text, along with the
+// words in them to be merged into the buffer's count. When only
+// indexing a file for the pager, batches carry page extents instead.
+struct load_batch {
+    struct erow **rows;
+    int n_rows;
+
+    struct cold_block **blocks;
+    int n_blocks;
+
+    struct words *words;
+
+    struct page_extent *extents;
+    int n_extents;
+
+    struct slab *slab;
+    struct load_batch *next;
+};
+
+struct loader;
+
+struct loader *loader_start(int fd, off_t offset, struct buffer *buffer, bool index_only);
+struct load_batch *loader_take(struct loader *loader, bool wait, bool *done);
+void loader_progress(struct loader *loader, size_t *bytes_read, size_t *bytes_total);
+bool loader_tail_partial(struct loader *loader);
+void load_batch_free(struct load_batch *batch);
+void loader_free(struct loader *loader);
+
+#endif // LOADER_H
@@ -0,0 +1,17 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stddef.h>
+
+#include "utils.h"
+
+// A small LZ77 codec in the spirit of LZ4, fast rather than tight. Each
+// sequence is a token holding the literal and match lengths, the literals, a
+// 16-bit offset back into the output and the rest of the match length. The
+// last sequence has literals only.
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+size_t lz_compress(const char *src, size_t n_src, char *dst);
+ERRCODE lz_decompress(const char *src, size_t n_src, char *dst, size_t n_dst);
+
+#endif // LZ_H
@@ -0,0 +1,26 @@
+#ifndef MACRO_H
+#define MACRO_H
+
+#include <stdbool.h>
+
+#include "input.h"
+
+// Keys recorded as they are processed. A replay feeds them back through
+// input_process_key inside one buffer transaction, so nothing is drawn until
+// it is done and the whole replay is undone in one step.
+struct buffer;
+
+struct macro {
+    KEY *keys;
+    int n_keys, keys_cap;
+    bool recording;
+};
+
+struct macro *macro_create(void);
+void macro_start(struct macro *macro);
+void macro_stop(struct macro *macro);
+void macro_record(struct macro *macro, KEY key);
+int macro_replay(struct macro *macro, struct buffer *buffer, int n_times);
+void macro_free(struct macro *macro);
+
+#endif // MACRO_H
@@ -0,0 +1,75 @@
+#ifndef PAGER_H
+#define PAGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "utils.h"
+
+// Files bigger than memory are never turned into rows as a whole. Only a
+// sparse index of pages stays resident, each page covering a run of lines,
+// and pages are decoded on demand into an LRU cache around the viewport.
+#define PAGER_PAGE_ROWS 1024
+#define PAGER_PAGE_BYTES (256 * 1024)
+// Edits that would go over the memory limit are refused. Only showing a page
+// isn't: one that is bigger than the limit by itself, a single huge line, is
+// still read in once everything else has been evicted.
+#define PAGER_MIN_MEM_LIMIT (16 * 1024 * 1024)
+
+struct buffer;
+struct erow;
+struct slab;
+
+struct page_extent {
+    off_t offset;
+    size_t n_bytes;
+    int n_rows;
+};
+
+struct page {
+    // Where the page lives in the file, n_rows is what it holds now
+    struct page_extent extent;
+    int first_row, n_rows;
+
+    // NULL unless resident. Rows of clean pages come from the page's own
+    // slab so eviction gives memory back, those of dirty pages (edits kept
+    // until save) come from the buffer's.
+    struct erow **rows;
+    int rows_cap;
+    struct slab *slab;
+    size_t mem;
+
+    bool dirty;
+    int lru_prev, lru_next;
+};
+
+struct pager {
+    int fd;
+    struct buffer *buffer;
+
+    struct page *pages;
+    int n_pages, pages_cap;
+    int last_page;
+
+    // Resident clean pages, most recently used first
+    int lru_head, lru_tail;
+
+    size_t mem_pages, mem_limit;
+    size_t n_loads, n_evictions;
+};
+
+struct pager *pager_create(int fd, struct buffer *buffer, size_t mem_limit);
+void pager_append(struct pager *pager, const struct page_extent *extents, int n_extents);
+int pager_n_rows(struct pager *pager);
+bool pager_pop_page(struct pager *pager, struct page_extent *extent);
+struct erow *pager_get_row(struct pager *pager, int at);
+struct erow *pager_edit_row(struct pager *pager, int at);
+int pager_find_row(struct pager *pager, const struct erow *erow);
+bool pager_insert_row(struct pager *pager, struct erow *erow, int at);
+bool pager_delete_row(struct pager *pager, int at);
+ERRCODE pager_write(struct pager *pager, const char *filename, size_t *bytes_written);
+size_t pager_mem_used(struct pager *pager);
+void pager_free(struct pager *pager);
+
+#endif // PAGER_H
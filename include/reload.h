@@ -0,0 +1,10 @@
+#ifndef RELOAD_H
+#define RELOAD_H
+
+#include "utils.h"
+
+struct buffer;
+
+ERRCODE reload_buffer(struct buffer *buffer, int *n_changed, int *n_hunks);
+
+#endif // RELOAD_H
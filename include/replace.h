@@ -0,0 +1,14 @@
+#ifndef REPLACE_H
+#define REPLACE_H
+
+#include <stddef.h>
+
+// Every row with a match is rebuilt once, into a fresh row, spread over all
+// cores for big buffers. Matches are literal and found left to right without
+// overlapping.
+struct buffer;
+
+size_t replace_all(struct buffer *buffer, int from, int to, const char *pattern, const char *with,
+                   int *n_changed);
+
+#endif // REPLACE_H
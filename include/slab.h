@@ -0,0 +1,43 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// Size classes go 8, 16, 24, 32, 48, 64, ... 3072, 4096. Anything bigger is
+// handed to malloc, but still tracked so that slab_reset can release it.
+#define SLAB_N_CLASSES 18
+#define SLAB_MAX_SIZE 4096
+#define SLAB_CHUNK_SIZE (64 * 1024)
+#define SLAB_MIN_CHUNK_SIZE (8 * 1024)
+
+struct slab_chunk;
+struct slab_large;
+
+struct slab {
+    struct slab_chunk *chunks;
+    struct slab_large *large;
+    void *free_lists[SLAB_N_CLASSES];
+
+    // Chunks start small and double up to SLAB_CHUNK_SIZE, so that a slab
+    // holding only a few rows doesn't cost a whole chunk
+    char *next, *end;
+    size_t chunk_size;
+
+    size_t n_bytes_payload;
+    size_t n_bytes_reserved;
+    size_t n_allocs;
+
+    // Every allocation and free since the slab was created, for the stats
+    // command. Unlike the above these survive slab_reset.
+    size_t n_allocs_total, n_frees_total;
+};
+
+struct slab *slab_create(void);
+void *slab_alloc(struct slab *slab, size_t size);
+void *slab_realloc(struct slab *slab, void *ptr, size_t old_size, size_t new_size);
+void slab_dealloc(struct slab *slab, void *ptr, size_t size);
+void slab_merge(struct slab *dst, struct slab *src);
+void slab_reset(struct slab *slab);
+void slab_free(struct slab *slab);
+
+#endif // SLAB_H
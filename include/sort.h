@@ -0,0 +1,12 @@
+#ifndef SORT_H
+#define SORT_H
+
+// Rows are reordered as pointers, never copying their text. Sorting is by
+// bytes, like sort(1) in the C locale, and stable.
+struct erow;
+
+void sort_rows(struct erow **rows, int n_rows);
+void sort_reverse(struct erow **rows, int n_rows);
+int sort_unique(struct erow **rows, int n_rows, struct erow **dropped);
+
+#endif // SORT_H
@@ -0,0 +1,24 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+
+struct buffer;
+
+// What a buffer's rows take up, as shown by the stats command. Text is counted
+// as edited, before any sharing or compression. The overhead is what the row
+// allocator holds beyond that and the row table's unused slots.
+struct buffer_stats {
+    int n_rows, rows_cap;
+    size_t n_bytes_chars, n_bytes_rchars;
+    size_t n_bytes_overhead;
+
+    // Since the buffer was created, rows and row table together. Only the
+    // table is ever reallocated.
+    size_t n_allocs, n_frees, n_reallocs;
+};
+
+void stats_buffer(struct buffer *buffer, struct buffer_stats *stats);
+size_t stats_rss(void);
+
+#endif // STATS_H
@@ -0,0 +1,42 @@
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+#include <stdbool.h>
+
+// Each row keeps its highlighting along with the lexer state it started and
+// ended in. A row is only highlighted again when its text changed or the row
+// before it now ends in a different state, and never past the last row on
+// screen, so an edit costs the rows it actually affects.
+#define SYNTAX_NUMBERS (1 << 0)
+#define SYNTAX_STRINGS (1 << 1)
+
+enum highlight {
+    HL_NORMAL = 0,
+    HL_COMMENT,
+    HL_MLCOMMENT,
+    HL_KEYWORD1,
+    HL_KEYWORD2,
+    HL_STRING,
+    HL_NUMBER,
+};
+
+struct buffer;
+
+struct syntax {
+    const char *filetype;
+    const char **filematch;
+
+    // Keywords ending in '|' get the second color
+    const char **keywords;
+
+    const char *sl_comment_start;
+    const char *ml_comment_start, *ml_comment_end;
+
+    int flags;
+};
+
+const struct syntax *syntax_select(const char *filename);
+void syntax_update(struct buffer *buffer, int upto);
+int syntax_color(enum highlight hl);
+
+#endif // SYNTAX_H
@@ -1,6 +1,8 @@
 #ifndef TERMINAL_H
 #define TERMINAL_H
 
+#include <stdbool.h>
+
 #include "input.h"
 #include "utils.h"
 
@@ -18,5 +20,6 @@ ERRCODE terminal_get_cursor_pos(int *row, int *col);
 ERRCODE terminal_set_cursor_pos(int, int);
 
 KEY terminal_read_key(void);
+bool terminal_key_pending(void);
 
 #endif // TERMINAL_H
@@ -2,5 +2,6 @@
 #define UI_H
 
 void ui_draw_screen(void);
+void ui_draw_message(void);
 
 #endif // UI_H
@@ -0,0 +1,49 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "utils.h"
+
+// History is kept as the edits themselves, each holding only the text it
+// inserted or deleted, grouped into steps of one command each. Runs of typed
+// or deleted characters are folded into a single edit. Once the history
+// takes more than its memory limit, the oldest steps are dropped.
+struct buffer;
+struct edit;
+
+struct undo_entry {
+    int type, row;
+    size_t at;
+
+    char *chars;
+    size_t n_chars;
+
+    // Where the cursor was before the step, and whether this starts one
+    int cx, cy;
+    bool step_start;
+};
+
+struct undo {
+    struct undo_entry *entries;
+    int n_entries, entries_cap;
+
+    // Entries before n_done can be undone, the rest redone
+    int n_done, n_saved;
+
+    size_t mem, mem_limit;
+    bool sealed, applying;
+    int sealed_cx, sealed_cy;
+};
+
+struct undo *undo_create(size_t mem_limit);
+void undo_record(struct undo *undo, const struct edit *edit);
+void undo_seal(struct undo *undo, int cx, int cy);
+void undo_mark_saved(struct undo *undo);
+ERRCODE undo_step_back(struct undo *undo, struct buffer *buffer);
+ERRCODE undo_step_forward(struct undo *undo, struct buffer *buffer);
+void undo_clear(struct undo *undo);
+void undo_free(struct undo *undo);
+
+#endif // UNDO_H
@@ -1,6 +1,9 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #define MAX(a,b) (((a)>(b))?(a):(b))
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define CLAMP(value, min, max) MIN(MAX(value, min), max)
@@ -8,10 +11,17 @@
 #define _STRINGIZE(x) #x
 #define STRINGIZE(x) _STRINGIZE(x)
 
+// The most threads a command spreads its work over
+#define UTILS_MAX_THREADS 16
+
 typedef int ERRCODE;
 #define RETURN(code) do {errcode = code; goto END;} while(0)
 
 void die(const char *context);
+int64_t utils_now(void);
+bool utils_progress(int64_t *shown_at, const char *fmt, ...);
+int utils_n_threads(int n_items, int min_per_thread);
+void utils_parallel(void *(*run)(void *), void *tasks, size_t task_size, int n_tasks);
 
 /*****************************************************************************/
 
@@ -20,6 +30,10 @@ struct append_buf {
     int n_chars;
 };
 
+// Counted since start, for the stats command. Appending to a buffer that has
+// text already is a reallocation, not a new allocation.
+extern size_t ab_n_allocs, ab_n_frees, ab_n_reallocs;
+
 struct append_buf *ab_create(void);
 void ab_append(struct append_buf *ab, const char *chars, int n_chars);
 void ab_free(struct append_buf *ab);
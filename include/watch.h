@@ -0,0 +1,15 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdbool.h>
+
+// Tells whether a file has been written to, or replaced by another file of the
+// same name, since the last poll. Uses inotify where available and falls back
+// to comparing stat results otherwise.
+struct watch;
+
+struct watch *watch_create(const char *filename);
+bool watch_poll(struct watch *watch);
+void watch_free(struct watch *watch);
+
+#endif // WATCH_H
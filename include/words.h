@@ -0,0 +1,37 @@
+#ifndef WORDS_H
+#define WORDS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Every word in a buffer, counted in a trie so that completing a prefix only
+// walks the words that start with it. The loader counts the words of each
+// batch off the main thread, and edits then adjust the counts around what
+// they change rather than recounting rows.
+#define WORDS_MIN_LEN 3
+#define WORDS_MAX_LEN 64
+
+struct words_node {
+    // Siblings are kept in byte order, 0 ends a list as the root is no child
+    int child, next;
+    unsigned char c;
+
+    // Occurrences of the word ending here, and of all words from here down
+    unsigned n_here, n_below;
+};
+
+struct words {
+    struct words_node *nodes;
+    int n_nodes, nodes_cap;
+};
+
+struct words *words_create(void);
+bool words_is_char(char c);
+void words_count(struct words *words, const char *chars, size_t n_chars, int delta);
+void words_edit_begin(struct words *words, const char *chars, size_t n_chars, size_t at, size_t n_removed);
+void words_edit_end(struct words *words, const char *chars, size_t n_chars, size_t at, size_t n_inserted);
+void words_merge(struct words *dst, const struct words *src, int sign);
+int words_complete(const struct words *words, const char *prefix, size_t n_prefix, int skip, char *match);
+void words_free(struct words *words);
+
+#endif // WORDS_H
@@ -1,14 +1,45 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "buffer.h"
+#include "cold.h"
+#include "cursor.h"
 #include "erow.h"
+#include "idxcache.h"
+#include "intern.h"
+#include "journal.h"
+#include "killring.h"
+#include "kilo.h"
+#include "loader.h"
+#include "pager.h"
+#include "reload.h"
+#include "slab.h"
+#include "syntax.h"
+#include "undo.h"
 #include "utils.h"
+#include "watch.h"
+#include "words.h"
+
+#ifdef __APPLE__
+#define st_mtim st_mtimespec
+#endif
 
+static void buffer_create_store(struct buffer *buffer);
 static void buffer_free_rows(struct buffer *buffer);
-static char *buffer_get_string(struct buffer *buffer, size_t *len_p);
+static void buffer_drop_journal(struct buffer *buffer);
+static void buffer_track_edit(struct buffer *buffer, const struct edit *edit);
+static bool buffer_same_version(const struct stat *a, const struct stat *b);
+static bool buffer_splice_rows(struct buffer *buffer, int at, int n_old, struct erow **rows, int n_new,
+                               bool reorder);
+static void buffer_reserve_rows(struct buffer *buffer, int n_rows);
+static void buffer_shift_mark(struct buffer *buffer, int at, int n_old, int n_new);
 
 struct buffer *buffer_create(void) {
     struct buffer *buffer = malloc(sizeof(struct buffer));
@@ -19,60 +50,364 @@ struct buffer *buffer_create(void) {
     buffer->row_off = buffer->col_off = 0;
 
     buffer->rows = NULL;
-    buffer->n_rows = 0;
+    buffer->n_rows = buffer->rows_cap = 0;
+    buffer->n_table_allocs = buffer->n_table_frees = buffer->n_table_reallocs = 0;
+
+    buffer->slab = slab_create();
+    buffer->loader = NULL;
+    buffer->pager = NULL;
+    buffer->cold = NULL;
+    buffer->intern = NULL;
+    buffer->words = words_create();
+
+    buffer->watch = NULL;
+    buffer->file_size = 0;
+    buffer->tail_partial = buffer->merge_tail = false;
+    buffer->follow = buffer->stale = false;
+
+    memset(&buffer->file_stat, 0, sizeof(struct stat));
+    buffer->disk_changed = false;
+
+    buffer->syntax = NULL;
+    buffer->hl_from = 0;
+
+    buffer->journal = NULL;
+    buffer->journal_failed = buffer->untracked = false;
+    buffer->edit_hint = 0;
+    buffer->undo = undo_create(E.undo_limit);
+
+    buffer->n_open = 0;
+    buffer->mark = -1;
 
     buffer->modified = false;
 
     return buffer;
 }
 
-ERRCODE buffer_read_file(struct buffer *buffer, const char *filename) {
-    ERRCODE errcode = 0;
+// Drops the rows and everything tied to them, for reading in new ones
+static void buffer_clear(struct buffer *buffer) {
+    if (buffer->loader) {
+        loader_free(buffer->loader);
+        buffer->loader = NULL;
+    }
+
+    buffer_free_rows(buffer);
+    buffer->words = words_create();
+
+    buffer_drop_journal(buffer);
 
-    if (buffer->filename) free(buffer->filename);
+    buffer->modified = false;
+    buffer->file_size = 0;
+    buffer->tail_partial = buffer->merge_tail = buffer->stale = false;
+
+    buffer->hl_from = 0;
+    buffer->disk_changed = false;
+    buffer->mark = -1;
+
+    if (buffer->watch) {
+        watch_free(buffer->watch);
+        buffer->watch = NULL;
+    }
+
+    memset(&buffer->file_stat, 0, sizeof(struct stat));
+}
+
+// Only opens the file, the rows are read by a loader thread and show up as
+// buffer_poll_load publishes them
+ERRCODE buffer_read_file(struct buffer *buffer, const char *filename) {
+    // filename may be the buffer's own, when reading it in again
     size_t filename_len = strlen(filename);
-    buffer->filename = malloc(filename_len);
-    memcpy(buffer->filename, filename, filename_len);
+    char *copy = malloc(filename_len + 1);
+    memcpy(copy, filename, filename_len + 1);
 
-    if (buffer->rows)
-        buffer_free_rows(buffer);
+    free(buffer->filename);
+    buffer->filename = copy;
 
-    size_t buf_cap = 64;
-    char *buf = malloc(buf_cap);
+    // The history of a buffer that was unloaded still applies if the file is
+    // as it was when the rows were dropped
+    struct stat last = buffer->file_stat;
+    bool saved = !buffer->modified;
 
-    FILE *file = fopen(filename, "r");
-    if (file == NULL)
-        RETURN(-1);
+    buffer_clear(buffer);
+    buffer->syntax = syntax_select(buffer->filename);
 
-    while (true) {
-        char c;
-        size_t buf_size = 0;
+    struct stat st;
+    int fd = open(buffer->filename, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) == -1)
+        memset(&st, 0, sizeof(struct stat));
 
-        while ((c = getc(file)) != '\n' && c != EOF) {
-            if (buf_size >= buf_cap)
-                buf = realloc(buf, buf_cap *= 2);
+    if (!saved || fd == -1 || !buffer_same_version(&st, &last)) {
+        undo_clear(buffer->undo);
+        undo_mark_saved(buffer->undo);
+    }
+
+    if (fd == -1)
+        return -1;
 
-            buf[buf_size++] = c;
+    buffer->watch = watch_create(buffer->filename);
+
+    // Files that would not comfortably fit as rows are paged in on demand
+    buffer->file_stat = st;
+
+    bool paged = E.force_paged || (size_t) st.st_size > E.mem_limit / 2;
+
+    if (paged) {
+        buffer->pager = pager_create(fd, buffer, E.mem_limit);
+
+        // Words are only counted for rows held in memory
+        words_free(buffer->words);
+        buffer->words = NULL;
+
+        if (E.index_cache && idxcache_load(buffer->filename, buffer->pager) == 0) {
+            buffer->n_rows = pager_n_rows(buffer->pager);
+            buffer->file_size = st.st_size;
+
+            char last;
+            buffer->tail_partial = st.st_size && pread(fd, &last, 1, st.st_size - 1) == 1 && last != '\n';
+        } else buffer->loader = loader_start(dup(fd), 0, buffer, true);
+    } else {
+        buffer_create_store(buffer);
+        buffer->loader = loader_start(fd, 0, buffer, false);
+    }
+
+    return 0;
+}
+
+// Streams rows in from fd, usually a pipe, as they are written to it. The
+// buffer has no file until it is saved as one.
+void buffer_read_fd(struct buffer *buffer, int fd) {
+    free(buffer->filename);
+    buffer->filename = NULL;
+
+    buffer_clear(buffer);
+    buffer->syntax = NULL;
+
+    undo_clear(buffer->undo);
+    undo_mark_saved(buffer->undo);
+
+    buffer_create_store(buffer);
+    buffer->loader = loader_start(fd, 0, buffer, false);
+}
+
+// Appends whatever the loader has finished so far, returns true if anything
+// changed. With wait set, returns only once the whole file is in.
+bool buffer_poll_load(struct buffer *buffer, bool wait) {
+    if (buffer->loader == NULL)
+        return false;
+
+    bool done;
+    struct load_batch *batch = loader_take(buffer->loader, wait, &done);
+    bool changed = done || batch;
+
+    while (batch) {
+        struct load_batch *next = batch->next;
+
+        if (batch->n_extents) {
+            pager_append(buffer->pager, batch->extents, batch->n_extents);
+
+            for (int i = 0; i < batch->n_extents; i++)
+                buffer->n_rows += batch->extents[i].n_rows;
+        }
+
+        if (batch->n_rows) {
+            slab_merge(buffer->slab, batch->slab);
+            batch->slab = NULL;
+
+            if (buffer->words && batch->words)
+                words_merge(buffer->words, batch->words, 1);
+
+            for (int i = 0; i < batch->n_blocks; i++)
+                cold_add(buffer->cold, batch->blocks[i]);
+            batch->n_blocks = 0;
+
+            if (buffer->intern)
+                intern_adopt(buffer->intern, batch->rows, batch->n_rows, buffer->slab);
+
+            // What was appended to a partial last line continues it
+            int first = 0;
+            if (buffer->merge_tail && buffer->n_rows) {
+                struct erow *tail = buffer_edit_row(buffer, buffer->n_rows - 1), *head = batch->rows[0];
+                bool modified = buffer->modified;
+
+                if (buffer->cold)
+                    cold_touch(buffer->cold, head);
+
+                // The head's words are counted again as part of the tail
+                if (buffer->words)
+                    words_count(buffer->words, head->chars, head->n_chars, -1);
+
+                buffer->untracked = true;
+                erow_insert_chars(tail, head->chars, head->n_chars, tail->n_chars);
+                buffer->untracked = false;
+                buffer->hl_from = MIN(buffer->hl_from, buffer->n_rows - 1);
+                erow_free(head);
+
+                buffer->modified = modified;
+                first = 1;
+            }
+            buffer->merge_tail = false;
+
+            // A batch can hold nothing but the rest of the tail, and the
+            // table may not be allocated yet
+            int n_rows = batch->n_rows - first;
+            if (n_rows) {
+                buffer_reserve_rows(buffer, buffer->n_rows + n_rows);
+
+                memcpy(buffer->rows + buffer->n_rows, batch->rows + first, sizeof(struct erow *) * n_rows);
+                buffer->n_rows += n_rows;
+            }
         }
 
-        struct erow* erow = erow_create(buf, buf_size, buffer);
-        buffer_insert_row(buffer, erow, buffer->n_rows);
+        load_batch_free(batch);
 
-        if (c == EOF)
-            break;
+        batch = next;
     }
 
-    if (buffer->rows[buffer->n_rows - 1]->n_chars == 0)
-        buffer_delete_row(buffer, buffer->n_rows - 1);
+    if (done) {
+        size_t bytes_read, bytes_total;
+        loader_progress(buffer->loader, &bytes_read, &bytes_total);
 
-END:
-    if (file != NULL)
-        fclose(file);
+        buffer->file_size += bytes_read;
+        if (bytes_read)
+            buffer->tail_partial = loader_tail_partial(buffer->loader);
 
-    if (buf != NULL)
-        free(buf);
+        loader_free(buffer->loader);
+        buffer->loader = NULL;
 
-    buffer->modified = false;
+        if (stat(buffer->filename, &buffer->file_stat) == -1)
+            memset(&buffer->file_stat, 0, sizeof(struct stat));
+
+        if (buffer->pager && E.index_cache)
+            idxcache_store(buffer->filename, buffer->pager);
+    }
+
+    return changed;
+}
+
+bool buffer_is_loading(struct buffer *buffer) {
+    return buffer->loader != NULL;
+}
+
+// Drops the rows of a buffer with nothing unsaved to free their memory. The
+// file name, cursor, viewport and undo history stay, for buffer_read_file to
+// pick up again, along with what the file was like to check that it still is.
+void buffer_unload(struct buffer *buffer) {
+    struct stat st = buffer->file_stat;
+    buffer_clear(buffer);
+    buffer->file_stat = st;
+
+    if (buffer->words) {
+        words_free(buffer->words);
+        buffer->words = NULL;
+    }
+}
+
+// Roughly what the rows take, whether held in full, paged or compressed
+size_t buffer_mem_used(struct buffer *buffer) {
+    size_t mem = buffer->slab->n_bytes_reserved + sizeof(struct erow *) * buffer->rows_cap;
+
+    if (buffer->pager)
+        mem += pager_mem_used(buffer->pager);
+    if (buffer->cold)
+        mem += buffer->cold->n_bytes_data;
+    if (buffer->words)
+        mem += sizeof(struct words_node) * buffer->words->nodes_cap;
+
+    return mem;
+}
+
+static bool buffer_same_file(const struct stat *a, const struct stat *b) {
+    return a->st_ino == b->st_ino && a->st_dev == b->st_dev;
+}
+
+// Checks the file for changes. In follow mode, whatever was appended since it
+// was last read gets loaded in like the rest of the file was. Anything else
+// is left for the caller to reload.
+enum file_event buffer_poll_file(struct buffer *buffer) {
+    if (buffer->watch == NULL)
+        return FILE_UNCHANGED;
+
+    buffer->stale |= watch_poll(buffer->watch);
+    if (!buffer->stale || buffer->loader)
+        return FILE_UNCHANGED;
+
+    buffer->stale = false;
+
+    struct stat st, *last = &buffer->file_stat;
+    if (stat(buffer->filename, &st) == -1)
+        return FILE_UNCHANGED;
+
+    if (buffer_same_version(&st, last) && st.st_size == buffer->file_size)
+        return FILE_UNCHANGED;
+
+    // Only a file that grew is taken to have been appended to, and only when
+    // following it. What was there before is not checked.
+    if (!buffer->follow || !buffer_same_file(&st, last) || st.st_size <= buffer->file_size)
+        return FILE_CHANGED;
+
+    int fd = open(buffer->filename, O_RDONLY);
+    if (fd == -1)
+        return FILE_UNCHANGED;
+
+    if (buffer->pager) {
+        // A partial last line is re-indexed whole along with the new data
+        struct page_extent extent;
+        if (buffer->tail_partial && pager_pop_page(buffer->pager, &extent)) {
+            buffer->n_rows -= extent.n_rows;
+            buffer->file_size = extent.offset;
+        }
+
+        buffer->loader = loader_start(fd, buffer->file_size, buffer, true);
+    } else {
+        buffer->merge_tail = buffer->tail_partial;
+        buffer->loader = loader_start(fd, buffer->file_size, buffer, false);
+    }
+
+    return FILE_APPENDED;
+}
+
+// Brings the buffer back in line with the file after it was changed on disk.
+// Only rows that differ are replaced, so the cursor and viewport stay on the
+// same text. Paged and compressed buffers are read in again instead, keeping
+// the cursor line.
+ERRCODE buffer_reload_file(struct buffer *buffer, int *n_changed, int *n_hunks) {
+    if (buffer->filename == NULL)
+        return -1;
+
+    if (buffer->loader) {
+        loader_free(buffer->loader);
+        buffer->loader = NULL;
+    }
+
+    ERRCODE errcode;
+    *n_changed = *n_hunks = 0;
+
+    if (buffer->pager || buffer->cold) {
+        int cy = buffer->cy, row_off = buffer->row_off;
+
+        char *filename = strdup(buffer->filename);
+        errcode = buffer_read_file(buffer, filename);
+        free(filename);
+
+        // Scanning for line ends is quick next to decoding rows
+        buffer_poll_load(buffer, true);
+
+        buffer->cy = MIN(cy, buffer->n_rows);
+        buffer->row_off = MIN(row_off, buffer->cy);
+    } else {
+        errcode = reload_buffer(buffer, n_changed, n_hunks);
+        buffer->merge_tail = buffer->stale = false;
+    }
+
+    buffer->hl_from = 0;
+
+    if (errcode == 0) {
+        buffer->disk_changed = false;
+        buffer_drop_journal(buffer);
+
+        undo_clear(buffer->undo);
+        undo_mark_saved(buffer->undo);
+    }
 
     return errcode;
 }
@@ -86,6 +421,15 @@ ERRCODE buffer_write_file(struct buffer *buffer, size_t *bytes_written) {
     if (buffer->filename == NULL)
         RETURN(-1);
 
+    if (buffer->pager) {
+        errcode = pager_write(buffer->pager, buffer->filename, bytes_written);
+
+        if (errcode == 0 && E.index_cache)
+            idxcache_store(buffer->filename, buffer->pager);
+
+        goto END;
+    }
+
     size_t n_chars;
     write_buffer = buffer_get_string(buffer, &n_chars);
 
@@ -104,9 +448,22 @@ END:
     if (write_buffer)
         free(write_buffer);
 
-    if (errcode == 0)
+    if (errcode == 0) {
         buffer->modified = false;
 
+        // The file now holds exactly the buffer, and may be a new inode
+        buffer->file_size = *bytes_written;
+        buffer->tail_partial = buffer->stale = buffer->disk_changed = false;
+        buffer_drop_journal(buffer);
+        undo_mark_saved(buffer->undo);
+
+        if (stat(buffer->filename, &buffer->file_stat) == -1)
+            memset(&buffer->file_stat, 0, sizeof(struct stat));
+
+        if (buffer->watch) watch_free(buffer->watch);
+        buffer->watch = watch_create(buffer->filename);
+    }
+
     return errcode;
 }
 
@@ -114,11 +471,12 @@ ERRCODE buffer_get_row_chars(struct buffer *buffer, char **chars, size_t *n_char
     if (buffer == NULL)
         return -1;
 
-    if (!(0 <= at && at <= buffer->n_rows))
+    struct erow *erow = buffer_get_row(buffer, at);
+    if (erow == NULL)
         return -2;
 
-    if (chars) *chars = buffer->rows[at]->chars;
-    if (n_chars) *n_chars = buffer->rows[at]->n_chars;
+    if (chars) *chars = erow->chars;
+    if (n_chars) *n_chars = erow->n_chars;
 
     return 0;
 }
@@ -127,45 +485,232 @@ ERRCODE buffer_get_row_rchars(struct buffer *buffer, char **rchars, size_t *n_rc
     if (buffer == NULL)
         return -1;
 
-    if (!(0 <= at && at <= buffer->n_rows))
+    struct erow *erow = buffer_get_row(buffer, at);
+    if (erow == NULL)
         return -2;
 
-    if (rchars) *rchars = buffer->rows[at]->rchars;
-    if (n_rchars) *n_rchars = buffer->rows[at]->n_rchars;
+    if (rchars) *rchars = erow->rchars;
+    if (n_rchars) *n_rchars = erow->n_rchars;
 
     return 0;
 }
 
-void buffer_insert_row(struct buffer *buffer, struct erow *erow, int at) {
+// With a pager, the returned row only stays valid until the next lookup of a
+// row from a different page
+struct erow *buffer_get_row(struct buffer *buffer, int at) {
+    if (!(0 <= at && at < buffer->n_rows))
+        return NULL;
+
+    if (buffer->pager)
+        return pager_get_row(buffer->pager, at);
+
+    if (buffer->cold)
+        cold_touch(buffer->cold, buffer->rows[at]);
+
+    return buffer->rows[at];
+}
+
+// Must be used instead of buffer_get_row for rows about to be edited. Rows
+// returned by this stay valid until the buffer is saved. NULL means the
+// row is out of range or the pager is out of memory for more edits.
+struct erow *buffer_edit_row(struct buffer *buffer, int at) {
+    if (!(0 <= at && at < buffer->n_rows))
+        return NULL;
+
+    if (buffer->pager)
+        return pager_edit_row(buffer->pager, at);
+
+    if (buffer->cold)
+        cold_adopt(buffer->cold, buffer->rows[at], buffer->slab);
+
+    return buffer->rows[at];
+}
+
+// Returns false, leaving the row to the caller, if at is out of range or the
+// pager is out of memory for more edits
+bool buffer_insert_row(struct buffer *buffer, struct erow *erow, int at) {
     if (!(0 <= at && at <= buffer->n_rows))
-        return;
+        return false;
+
+    if (buffer->pager && !pager_insert_row(buffer->pager, erow, at))
+        return false;
+
+    struct edit edit = { EDIT_INSERT_ROW, at, 0, erow->chars, erow->n_chars };
+    buffer_track_edit(buffer, &edit);
+
+    if (buffer->words)
+        words_count(buffer->words, erow->chars, erow->n_chars, 1);
+
+    buffer_shift_mark(buffer, at, 0, 1);
+
+    if (buffer->pager) {
+        buffer->n_rows++;
+        return true;
+    }
+
+    buffer_reserve_rows(buffer, buffer->n_rows + 1);
 
-    buffer->rows = realloc(buffer->rows, sizeof(struct erow *) * (buffer->n_rows + 1));
     memmove(buffer->rows + at + 1, buffer->rows + at, sizeof(struct erow *) * (buffer->n_rows - at));
 
     buffer->rows[at] = erow;
     buffer->n_rows++;
+    return true;
 }
 
-void buffer_delete_row(struct buffer *buffer, int at) {
+// Returns false under the same conditions as buffer_edit_row
+bool buffer_delete_row(struct buffer *buffer, int at) {
     if (!(0 <= at && at < buffer->n_rows))
-        return;
+        return false;
+
+    // Deleting from a page that isn't yet edited takes memory to adopt it
+    struct erow *erow = (buffer->pager ? buffer_edit_row(buffer, at) : buffer_get_row(buffer, at));
+    if (erow == NULL)
+        return false;
+
+    struct edit edit = { EDIT_DELETE_ROW, at, 0, erow->chars, erow->n_chars };
+    buffer_track_edit(buffer, &edit);
+
+    if (buffer->words)
+        words_count(buffer->words, erow->chars, erow->n_chars, -1);
+
+    buffer_shift_mark(buffer, at, 1, 0);
+
+    if (buffer->pager) {
+        pager_delete_row(buffer->pager, at);
+    } else {
+        erow_free(buffer->rows[at]);
+        memmove(buffer->rows + at, buffer->rows + at + 1, sizeof(struct erow *) * (buffer->n_rows - at - 1));
+    }
 
-    erow_free(buffer->rows[at]);
-    memmove(buffer->rows + at, buffer->rows + at + 1, sizeof(struct erow *) * (buffer->n_rows - at - 1));
     buffer->n_rows--;
 
     buffer->modified = true;
+    return true;
+}
+
+// Swaps n_old rows starting at at for rows, with the same effect as deleting
+// and inserting them one by one but moving the rest of the rows only once.
+// Returns false if the pager ran out of memory partway, the rows that didn't
+// go in are freed then.
+bool buffer_replace_rows(struct buffer *buffer, int at, int n_old, struct erow **rows, int n_new) {
+    return buffer_splice_rows(buffer, at, n_old, rows, n_new, false);
+}
+
+// Like buffer_replace_rows, but rows are the old rows themselves, reordered
+// or with some left out. Rows left out are the caller's to free.
+void buffer_reorder_rows(struct buffer *buffer, int at, int n_old, struct erow **rows, int n_new) {
+    if (buffer->pager)
+        return;
+
+    buffer_splice_rows(buffer, at, n_old, rows, n_new, true);
+}
+
+// Puts each of rows in place of the row at the same index in ats, freeing the
+// old ones. The same as deleting and inserting them one by one, but no other
+// row is moved. The caller has already counted the words that change.
+void buffer_swap_rows(struct buffer *buffer, const int *ats, struct erow **rows, int n_rows) {
+    for (int i = 0; i < n_rows; i++) {
+        int at = ats[i];
+        if (!(0 <= at && at < buffer->n_rows))
+            continue;
+
+        if (buffer->pager) {
+            if (!buffer_delete_row(buffer, at) || !buffer_insert_row(buffer, rows[i], at))
+                erow_free(rows[i]);
+            continue;
+        }
+
+        struct erow *erow = buffer_get_row(buffer, at);
+        struct edit deleted = { EDIT_DELETE_ROW, at, 0, erow->chars, erow->n_chars };
+        struct edit inserted = { EDIT_INSERT_ROW, at, 0, rows[i]->chars, rows[i]->n_chars };
+
+        buffer_track_edit(buffer, &deleted);
+        buffer_track_edit(buffer, &inserted);
+
+        erow_free(erow);
+        buffer->rows[at] = rows[i];
+        buffer->modified = true;
+    }
 }
 
 struct erow *buffer_get_crow(struct buffer *buffer) {
-    return (buffer->cy < buffer->n_rows ? buffer->rows[buffer->cy]: NULL);
+    return buffer_get_row(buffer, buffer->cy);
+}
+
+// Edits almost always happen at or right next to the cursor
+static int buffer_find_row(struct buffer *buffer, struct erow *erow) {
+    int hints[] = { buffer->edit_hint, buffer->cy, buffer->cy - 1, buffer->cy + 1 };
+
+    for (size_t i = 0; i < sizeof(hints) / sizeof(hints[0]); i++) {
+        int at = hints[i];
+        if (!(0 <= at && at < buffer->n_rows))
+            continue;
+
+        // Compressed rows are only compared, not thawed
+        struct erow *row = buffer->pager ? pager_get_row(buffer->pager, at) : buffer->rows[at];
+        if (row == erow)
+            return buffer->edit_hint = at;
+    }
+
+    if (buffer->pager)
+        return pager_find_row(buffer->pager, erow);
+
+    for (int at = 0; at < buffer->n_rows; at++) {
+        if (buffer->rows[at] == erow)
+            return buffer->edit_hint = at;
+    }
+
+    return -1;
+}
+
+// Called by the row edit primitives before they change anything
+void buffer_track_row_edit(struct buffer *buffer, struct erow *erow, enum edit_type type, size_t at,
+                           const char *chars, size_t n_chars) {
+    if (buffer->untracked)
+        return;
+
+    struct edit edit = { type, buffer_find_row(buffer, erow), at, chars, n_chars };
+    if (edit.row != -1)
+        buffer_track_edit(buffer, &edit);
+}
+
+// Every edit ends up here, to be passed on to the undo history and journal
+static void buffer_track_edit(struct buffer *buffer, const struct edit *edit) {
+    buffer->hl_from = MIN(buffer->hl_from, edit->row);
+
+    if (buffer->untracked)
+        return;
+
+    undo_record(buffer->undo, edit);
+
+    if (buffer->filename == NULL || buffer->journal_failed)
+        return;
+
+    if (buffer->journal == NULL) {
+        buffer->journal = journal_open(buffer->filename, &buffer->file_stat);
+        buffer->journal_failed = buffer->journal == NULL;
+    }
+
+    if (buffer->journal)
+        journal_record(buffer->journal, edit);
 }
 
 void buffer_free(struct buffer *buffer) {
     free(buffer->filename);
 
+    buffer_drop_journal(buffer);
+    undo_free(buffer->undo);
+
+    if (buffer->loader)
+        loader_free(buffer->loader);
+
+    if (buffer->watch)
+        watch_free(buffer->watch);
+
     buffer_free_rows(buffer);
+    slab_free(buffer->slab);
+
+    free(buffer);
 }
 
 size_t buffer_get_crow_len(struct buffer *buffer) {
@@ -174,17 +719,73 @@ size_t buffer_get_crow_len(struct buffer *buffer) {
     return crow ? crow->n_chars : 0;
 }
 
+// Edits made between this and buffer_commit go straight to the rows, with the
+// screen left alone until the outermost transaction is committed. buffer->cx
+// and cy are not kept in range or in view while one is open.
+void buffer_begin(struct buffer *buffer) {
+    buffer->n_open++;
+}
+
+// Leaves the cursor at cx, cy. Moving the viewport to it is done once, when
+// the outermost transaction ends, but the column vertical moves keep to is
+// updated every time, for the moves that follow within a macro replay.
+void buffer_commit(struct buffer *buffer, int cx, int cy) {
+    if (--buffer->n_open == 0) cursor_set(buffer, cx, cy);
+    else cursor_place(buffer, cx, cy);
+}
+
+// How rows that are read in get stored, compression taking precedence
+static void buffer_create_store(struct buffer *buffer) {
+    if (E.cold_rows) buffer->cold = cold_create(E.cold_rows);
+    else if (E.intern) buffer->intern = intern_create();
+}
+
+// Rows never outlive their buffer's slab, so there is no need to visit them
 static void buffer_free_rows(struct buffer *buffer) {
-    for (int i = 0; i < buffer->n_rows; i++)
-        erow_free(buffer->rows[i]);
+    if (E.kill_ring)
+        killring_release(E.kill_ring, buffer);
+
+    if (buffer->pager) {
+        pager_free(buffer->pager);
+        buffer->pager = NULL;
+    }
 
+    if (buffer->cold) {
+        cold_free(buffer->cold);
+        buffer->cold = NULL;
+    }
+
+    if (buffer->intern) {
+        intern_free(buffer->intern);
+        buffer->intern = NULL;
+    }
+
+    if (buffer->words) {
+        words_free(buffer->words);
+        buffer->words = NULL;
+    }
+
+    slab_reset(buffer->slab);
+
+    buffer->n_table_frees += buffer->rows != NULL;
     free(buffer->rows);
 
     buffer->rows = NULL;
-    buffer->n_rows = 0;
+    buffer->n_rows = buffer->rows_cap = 0;
 }
 
-static char *buffer_get_string(struct buffer *buffer, size_t *n_chars) {
+// Once the file on disk matches the buffer again, there is nothing to recover
+static void buffer_drop_journal(struct buffer *buffer) {
+    if (buffer->journal) {
+        journal_discard(buffer->journal);
+        buffer->journal = NULL;
+    }
+
+    buffer->journal_failed = false;
+}
+
+// The whole text, a newline after every row. Not for paged buffers.
+char *buffer_get_string(struct buffer *buffer, size_t *n_chars) {
     *n_chars = 0;
 
     for (int i = 0; i < buffer->n_rows; i++)
@@ -192,7 +793,7 @@ static char *buffer_get_string(struct buffer *buffer, size_t *n_chars) {
 
     char *write_buffer = malloc(*n_chars);
     for (int i = 0, j = 0; i < buffer->n_rows; i++) {
-        struct erow *row = buffer->rows[i];
+        struct erow *row = buffer_get_row(buffer, i);
 
         memcpy(write_buffer + j, row->chars, row->n_chars);
         j += row->n_chars;
@@ -201,3 +802,87 @@ static char *buffer_get_string(struct buffer *buffer, size_t *n_chars) {
 
     return write_buffer;
 }
+
+static bool buffer_splice_rows(struct buffer *buffer, int at, int n_old, struct erow **rows, int n_new,
+                               bool reorder) {
+    if (!(0 <= at && at + n_old <= buffer->n_rows))
+        return false;
+
+    if (buffer->pager) {
+        int n_deleted = 0, n_inserted = 0;
+        while (n_deleted < n_old && buffer_delete_row(buffer, at))
+            n_deleted++;
+        while (n_deleted == n_old && n_inserted < n_new && buffer_insert_row(buffer, rows[n_inserted], at + n_inserted))
+            n_inserted++;
+
+        for (int i = n_inserted; i < n_new; i++)
+            erow_free(rows[i]);
+
+        return n_inserted == n_new && n_deleted == n_old;
+    }
+
+    // Only rows left out of a reordering change what words there are
+    bool count_words = buffer->words && (!reorder || n_new != n_old);
+
+    for (int i = 0; i < n_old; i++) {
+        struct erow *erow = buffer_get_row(buffer, at + i);
+        struct edit edit = { EDIT_DELETE_ROW, at, 0, erow->chars, erow->n_chars };
+
+        buffer_track_edit(buffer, &edit);
+        if (count_words)
+            words_count(buffer->words, erow->chars, erow->n_chars, -1);
+        if (!reorder)
+            erow_free(erow);
+    }
+
+    for (int i = 0; i < n_new; i++) {
+        struct edit edit = { EDIT_INSERT_ROW, at + i, 0, rows[i]->chars, rows[i]->n_chars };
+
+        buffer_track_edit(buffer, &edit);
+        if (count_words)
+            words_count(buffer->words, rows[i]->chars, rows[i]->n_chars, 1);
+    }
+
+    buffer_shift_mark(buffer, at, n_old, n_new);
+
+    int n_rows = buffer->n_rows - n_old + n_new;
+    buffer_reserve_rows(buffer, n_rows);
+
+    if (n_new != n_old)
+        memmove(buffer->rows + at + n_new, buffer->rows + at + n_old,
+                sizeof(struct erow *) * (buffer->n_rows - at - n_old));
+    if (n_new)
+        memcpy(buffer->rows + at, rows, sizeof(struct erow *) * n_new);
+    buffer->n_rows = n_rows;
+
+    buffer->modified = true;
+    return true;
+}
+
+// Makes room for n_rows in the row table, at least doubling it when it grows
+static void buffer_reserve_rows(struct buffer *buffer, int n_rows) {
+    if (n_rows <= buffer->rows_cap)
+        return;
+
+    buffer->rows_cap = MAX(MAX(buffer->rows_cap * 2, n_rows), 64);
+    if (buffer->rows) buffer->n_table_reallocs++;
+    else buffer->n_table_allocs++;
+
+    buffer->rows = realloc(buffer->rows, sizeof(struct erow *) * buffer->rows_cap);
+}
+
+// Keeps the mark on the same line as n_old rows at at become n_new, clearing
+// it if its line goes
+static void buffer_shift_mark(struct buffer *buffer, int at, int n_old, int n_new) {
+    if (buffer->mark < at)
+        return;
+
+    if (buffer->mark < at + n_old) buffer->mark = -1;
+    else buffer->mark += n_new - n_old;
+}
+
+// The same file, last written at the same time and to the same size
+static bool buffer_same_version(const struct stat *a, const struct stat *b) {
+    return buffer_same_file(a, b) && a->st_size == b->st_size && a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+           a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
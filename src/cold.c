@@ -0,0 +1,249 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cold.h"
+#include "erow.h"
+#include "kilo.h"
+#include "lz.h"
+#include "slab.h"
+#include "utils.h"
+
+static void cold_thaw(struct cold *cold, struct cold_block *block);
+static void cold_freeze(struct cold *cold, struct cold_block *block);
+static void cold_drop(struct cold *cold, struct cold_block *block);
+
+// hot_rows is how far above and below the screen rows are left thawed, give
+// or take a block
+struct cold *cold_create(int hot_rows) {
+    struct cold *cold = malloc(sizeof(struct cold));
+
+    cold->blocks = NULL;
+    cold->n_blocks = cold->blocks_cap = 0;
+
+    cold->max_thawed = MAX((2 * hot_rows + E.screenrows) / COLD_BLOCK_ROWS + 2, 4);
+    cold->thawed = malloc(sizeof(struct cold_block *) * cold->max_thawed);
+    cold->n_thawed = 0;
+
+    cold->clock = 0;
+    cold->n_hits = cold->n_misses = 0;
+    cold->n_bytes_raw = cold->n_bytes_data = 0;
+
+    return cold;
+}
+
+struct cold_block *cold_block_create(void) {
+    struct cold_block *block = malloc(sizeof(struct cold_block));
+
+    block->rows = malloc(sizeof(struct erow *) * COLD_BLOCK_ROWS);
+    block->n_rows = block->n_live = 0;
+
+    block->data = NULL;
+    block->n_data = block->n_raw = 0;
+
+    // Until sealed, the text is gathered in raw
+    block->raw = malloc(COLD_BLOCK_BYTES);
+    block->render = NULL;
+    block->last_used = 0;
+
+    block->at = block->thawed_at = -1;
+
+    return block;
+}
+
+// Makes a frozen row in slab, its text going into the block
+struct erow *cold_block_add(struct cold_block *block, struct slab *slab, const char *chars, size_t n_chars,
+                            struct buffer *buffer) {
+    struct erow *erow = slab_alloc(slab, sizeof(struct erow));
+
+    erow->buffer = buffer;
+
+    erow->chars = erow->rchars = NULL;
+    erow->n_chars = n_chars;
+    erow->n_rchars = erow_render(chars, n_chars, NULL);
+
+    erow->hl = NULL;
+    erow->hl_in = erow->hl_out = 0;
+    erow->hl_stale = true;
+
+    erow->cold = block;
+    erow->shared = NULL;
+
+    // Only a single long line can go past the usual size
+    if (block->n_raw + n_chars + 1 > COLD_BLOCK_BYTES)
+        block->raw = realloc(block->raw, MAX(block->n_raw + n_chars + 1, COLD_BLOCK_BYTES));
+
+    memcpy(block->raw + block->n_raw, chars, n_chars);
+    block->raw[block->n_raw + n_chars] = '\n';
+    block->n_raw += n_chars + 1;
+
+    block->rows[block->n_rows++] = erow;
+    block->n_live++;
+
+    return erow;
+}
+
+bool cold_block_full(struct cold_block *block) {
+    return block->n_rows == COLD_BLOCK_ROWS || block->n_raw >= COLD_BLOCK_BYTES;
+}
+
+void cold_block_seal(struct cold_block *block) {
+    block->data = malloc(LZ_BOUND(block->n_raw));
+    block->n_data = lz_compress(block->raw, block->n_raw, block->data);
+    block->data = realloc(block->data, block->n_data);
+
+    free(block->raw);
+    block->raw = NULL;
+}
+
+void cold_block_free(struct cold_block *block) {
+    free(block->rows);
+    free(block->data);
+    free(block->raw);
+    free(block->render);
+    free(block);
+}
+
+void cold_add(struct cold *cold, struct cold_block *block) {
+    if (cold->n_blocks == cold->blocks_cap) {
+        cold->blocks_cap = MAX(cold->blocks_cap * 2, 64);
+        cold->blocks = realloc(cold->blocks, sizeof(struct cold_block *) * cold->blocks_cap);
+    }
+
+    block->at = cold->n_blocks;
+    cold->blocks[cold->n_blocks++] = block;
+
+    cold->n_bytes_raw += block->n_raw;
+    cold->n_bytes_data += block->n_data;
+}
+
+// Called on every row lookup, makes sure the row's text is there. The text
+// of other rows looked up before may be gone after this.
+void cold_touch(struct cold *cold, struct erow *erow) {
+    struct cold_block *block = erow->cold;
+
+    if (block && block->raw == NULL) {
+        cold_thaw(cold, block);
+        cold->n_misses++;
+    } else cold->n_hits++;
+
+    if (block)
+        block->last_used = ++cold->clock;
+}
+
+// Copies the row's text into slab and takes it out of its block, so that it
+// can be edited
+void cold_adopt(struct cold *cold, struct erow *erow, struct slab *slab) {
+    if (erow->cold == NULL)
+        return;
+
+    cold_touch(cold, erow);
+
+    char *chars = slab_alloc(slab, erow->n_chars), *rchars = slab_alloc(slab, erow->n_rchars);
+    if (erow->n_chars) memcpy(chars, erow->chars, erow->n_chars);
+    if (erow->n_rchars) memcpy(rchars, erow->rchars, erow->n_rchars);
+
+    cold_detach(cold, erow);
+
+    erow->chars = chars;
+    erow->rchars = rchars;
+}
+
+// For rows being freed or adopted. Blocks go once no row is left in them.
+void cold_detach(struct cold *cold, struct erow *erow) {
+    struct cold_block *block = erow->cold;
+
+    for (int i = 0; i < block->n_rows; i++) {
+        if (block->rows[i] == erow) {
+            block->rows[i] = NULL;
+            break;
+        }
+    }
+
+    erow->cold = NULL;
+
+    if (--block->n_live == 0)
+        cold_drop(cold, block);
+}
+
+void cold_free(struct cold *cold) {
+    for (int i = 0; i < cold->n_blocks; i++)
+        cold_block_free(cold->blocks[i]);
+
+    free(cold->blocks);
+    free(cold->thawed);
+    free(cold);
+}
+
+/*****************************************************************************/
+
+static void cold_thaw(struct cold *cold, struct cold_block *block) {
+    if (cold->n_thawed == cold->max_thawed) {
+        struct cold_block *lru = cold->thawed[0];
+        for (int i = 1; i < cold->n_thawed; i++) {
+            if (cold->thawed[i]->last_used < lru->last_used)
+                lru = cold->thawed[i];
+        }
+
+        cold_freeze(cold, lru);
+    }
+
+    block->raw = malloc(MAX(block->n_raw, 1));
+    if (lz_decompress(block->data, block->n_data, block->raw, block->n_raw) == -1)
+        die("cold_thaw");
+
+    size_t n_render = 0;
+    for (int i = 0; i < block->n_rows; i++) {
+        if (block->rows[i])
+            n_render += block->rows[i]->n_rchars;
+    }
+
+    block->render = malloc(MAX(n_render, 1));
+
+    char *line = block->raw, *rchars = block->render;
+    for (int i = 0; i < block->n_rows; i++) {
+        char *newline = memchr(line, '\n', block->raw + block->n_raw - line);
+        struct erow *erow = block->rows[i];
+
+        if (erow) {
+            erow->chars = line;
+            erow->rchars = rchars;
+            rchars += erow_render(line, erow->n_chars, rchars);
+        }
+
+        line = newline + 1;
+    }
+
+    block->thawed_at = cold->n_thawed;
+    cold->thawed[cold->n_thawed++] = block;
+}
+
+static void cold_freeze(struct cold *cold, struct cold_block *block) {
+    for (int i = 0; i < block->n_rows; i++) {
+        if (block->rows[i])
+            block->rows[i]->chars = block->rows[i]->rchars = NULL;
+    }
+
+    free(block->raw);
+    free(block->render);
+    block->raw = block->render = NULL;
+
+    struct cold_block *last = cold->thawed[--cold->n_thawed];
+    cold->thawed[block->thawed_at] = last;
+    last->thawed_at = block->thawed_at;
+    block->thawed_at = -1;
+}
+
+static void cold_drop(struct cold *cold, struct cold_block *block) {
+    if (block->thawed_at != -1)
+        cold_freeze(cold, block);
+
+    struct cold_block *last = cold->blocks[--cold->n_blocks];
+    cold->blocks[block->at] = last;
+    last->at = block->at;
+
+    cold->n_bytes_raw -= block->n_raw;
+    cold->n_bytes_data -= block->n_data;
+
+    cold_block_free(block);
+}
@@ -1,22 +1,90 @@
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
 
 #include "buffer.h"
 #include "commands.h"
 #include "cursor.h"
 #include "erow.h"
+#include "filter.h"
 #include "input.h"
+#include "killring.h"
 #include "kilo.h"
+#include "macro.h"
+#include "replace.h"
+#include "sort.h"
+#include "stats.h"
+#include "syntax.h"
 #include "terminal.h"
+#include "undo.h"
 #include "utils.h"
+#include "words.h"
+
+// The last loaded row may be followed by rows still on their way in, so
+// nothing may be added past it until loading is done
+static bool command_check_loaded(void) {
+    if (!buffer_is_loading(E.current_buf) || E.current_buf->cy < E.current_buf->n_rows)
+        return true;
+
+    editor_set_message("Still loading, can't edit past line %d yet", E.current_buf->n_rows);
+    return false;
+}
+
+// The marked lines, or the whole buffer when nothing is marked
+static void command_get_range(int *from, int *to) {
+    struct buffer *buffer = E.current_buf;
+
+    *from = 0, *to = buffer->n_rows;
+    if (buffer->mark != -1) {
+        *from = MIN(buffer->mark, buffer->cy);
+        *to = MIN(MAX(buffer->mark, buffer->cy) + 1, buffer->n_rows);
+    }
+}
+
+static struct erow *command_edit_row(int at) {
+    struct erow *erow = buffer_edit_row(E.current_buf, at);
+
+    if (erow == NULL)
+        editor_set_message("Memory limit of %zu MiB reached, save to keep editing", E.mem_limit >> 20);
+
+    return erow;
+}
+
+// Frees the row if the memory limit keeps it from going in
+static bool command_insert_row(struct erow *erow, int at) {
+    if (buffer_insert_row(E.current_buf, erow, at))
+        return true;
+
+    erow_free(erow);
+    editor_set_message("Memory limit of %zu MiB reached, save to keep editing", E.mem_limit >> 20);
+    return false;
+}
 
 void command_quit(void) {
-    if (E.current_buf->modified && E.quit_times) {
-        editor_set_message("Unsaved changed! Press quit %d more time(s)", E.quit_times);
+    int n_modified = 0;
+    for (int i = 0; i < E.n_buffers; i++)
+        n_modified += E.buffers[i].buffer->modified;
+
+    if (n_modified && E.quit_times) {
+        if (n_modified == 1 && E.current_buf->modified)
+            editor_set_message("Unsaved changed! Press quit %d more time(s)", E.quit_times);
+        else editor_set_message("Unsaved changes in %d file(s)! Press quit %d more time(s)",
+                                n_modified, E.quit_times);
         E.quit_times--;
     } else {
         terminal_clear();
+
+        // Before the buffers, which would have the ring copy its rows out
+        killring_free(E.kill_ring);
+        E.kill_ring = NULL;
+
+        for (int i = 0; i < E.n_buffers; i++)
+            buffer_free(E.buffers[i].buffer);
+        free(E.buffers);
+
+        macro_free(E.macro);
         exit(0);
     }
 }
@@ -53,67 +121,137 @@ void command_move_cursor(KEY key) {
 }
 
 void command_insert_line(void) {
-    struct erow *erow = erow_create(NULL, 0, E.current_buf);
+    struct buffer *buffer = E.current_buf;
+    if (!command_check_loaded())
+        return;
 
-    if (E.current_buf->cy == E.current_buf->n_rows) {
-        buffer_insert_row(E.current_buf, erow, E.current_buf->cy);
-    } else {
-        buffer_insert_row(E.current_buf, erow, E.current_buf->cy + 1);
+    struct erow *crow = NULL;
+    if (buffer->cy < buffer->n_rows && (crow = command_edit_row(buffer->cy)) == NULL)
+        return;
+
+    struct erow *erow = erow_create(NULL, 0, buffer);
+    if (!command_insert_row(erow, buffer->cy + (crow != NULL)))
+        return;
 
-        struct erow *crow = buffer_get_crow(E.current_buf);
+    buffer_begin(buffer);
 
-        erow_insert_chars(erow, crow->chars + E.current_buf->cx, crow->n_chars - E.current_buf->cx, 0);
-        erow_delete_chars(crow, crow->n_chars - E.current_buf->cx, E.current_buf->cx);
+    if (crow) {
+        erow_insert_chars(erow, crow->chars + buffer->cx, crow->n_chars - buffer->cx, 0);
+        erow_delete_chars(crow, crow->n_chars - buffer->cx, buffer->cx);
     }
 
-    input_process_key(ARROW_DOWN);
-    input_process_key(HOME);
+    buffer_commit(buffer, 0, buffer->cy + 1);
 }
 
 void command_insert_char(char c) {
-    struct erow *erow;
+    struct buffer *buffer = E.current_buf;
+    if (!command_check_loaded())
+        return;
+
+    struct erow *erow = NULL;
+    if (buffer->cy < buffer->n_rows && (erow = command_edit_row(buffer->cy)) == NULL)
+        return;
+
+    if (erow == NULL) {
+        erow = erow_create(NULL, 0, buffer);
+        if (!command_insert_row(erow, buffer->n_rows))
+            return;
+    }
 
-    if (E.current_buf->cy == E.current_buf->n_rows) {
-        erow = erow_create(NULL, 0, E.current_buf);
-        buffer_insert_row(E.current_buf, erow, E.current_buf->n_rows);
-    } else erow = buffer_get_crow(E.current_buf);
+    buffer_begin(buffer);
 
-    erow_insert_chars(erow, &c, 1, E.current_buf->cx);
-    input_process_key(ARROW_RIGHT);
+    erow_insert_chars(erow, &c, 1, buffer->cx);
+    buffer_commit(buffer, buffer->cx + 1, buffer->cy);
 }
 
-// TODO: Is this many simulated keypresses necessary? Is it bad?
+// Deletes the character before the cursor, joining the row onto the one above
+// when at its start
 void command_delete_char(void) {
-    if (E.current_buf->cy == E.current_buf->n_rows)
-        input_process_key(ARROW_LEFT);
+    struct buffer *buffer = E.current_buf;
+    if (!command_check_loaded())
+        return;
 
-    struct erow *crow = buffer_get_crow(E.current_buf);
+    int cx = buffer->cx, cy = buffer->cy;
 
-    if (E.current_buf->cx == 0) {
-        if (E.current_buf->cy == 0)
-            return;
+    // Past the last row there is nothing to delete but the row above's end
+    if (cy == buffer->n_rows && cy > 0) {
+        cy--;
+        cx = buffer_get_row(buffer, cy)->n_chars;
+    }
+
+    if (cx == 0 && cy == 0) {
+        cursor_set(buffer, cx, cy);
+        return;
+    }
+
+    struct erow *crow = command_edit_row(cy);
+    struct erow *prow = (crow && cx == 0 ? command_edit_row(cy - 1) : NULL);
+    if (crow == NULL || (cx == 0 && prow == NULL))
+        return;
 
-        struct erow *prow = E.current_buf->rows[E.current_buf->cy - 1];
+    buffer_begin(buffer);
 
-        input_process_key(HOME);
-        input_process_key(ARROW_UP);
-        cursor_move(E.current_buf, prow->n_chars, 0);
+    if (cx == 0) {
+        int n_chars = prow->n_chars;
 
         erow_insert_chars(prow, crow->chars, crow->n_chars, prow->n_chars);
-        buffer_delete_row(E.current_buf, E.current_buf->cy + 1);
+        buffer_delete_row(buffer, cy);
+        buffer_commit(buffer, n_chars, cy - 1);
     } else {
-        erow_delete_chars(crow, 1, E.current_buf->cx - 1);
-        input_process_key(ARROW_LEFT);
+        erow_delete_chars(crow, 1, cx - 1);
+        buffer_commit(buffer, cx - 1, cy);
     }
 }
 
+// Deletes the character under the cursor, joining the next row onto this one
+// when at its end
+void command_delete_next_char(void) {
+    struct buffer *buffer = E.current_buf;
+    if (!command_check_loaded() || buffer->cy == buffer->n_rows)
+        return;
+
+    struct erow *crow = command_edit_row(buffer->cy);
+    if (crow == NULL)
+        return;
+
+    bool join = (size_t) buffer->cx == crow->n_chars;
+    if (join && buffer->cy + 1 == buffer->n_rows)
+        return;
+
+    struct erow *nrow = (join ? command_edit_row(buffer->cy + 1) : NULL);
+    if (join && nrow == NULL)
+        return;
+
+    buffer_begin(buffer);
+
+    if (join) {
+        erow_insert_chars(crow, nrow->chars, nrow->n_chars, crow->n_chars);
+        buffer_delete_row(buffer, buffer->cy + 1);
+    } else erow_delete_chars(crow, 1, buffer->cx);
+
+    buffer_commit(buffer, buffer->cx, buffer->cy);
+}
+
 void command_save_buffer(void) {
+    if (buffer_is_loading(E.current_buf)) {
+        editor_set_message("Can't save while the file is still loading");
+        return;
+    }
+
     if (E.current_buf->filename == NULL) {
-        E.current_buf->filename = editor_prompt("Save as: %s (ESC to cancel)");
+        E.current_buf->filename = editor_prompt("Save as: %s (ESC to cancel)", false);
         if (E.current_buf->filename == NULL) {
             editor_set_message("Save aborted");
             return;
         }
+
+        E.current_buf->syntax = syntax_select(E.current_buf->filename);
+        E.current_buf->hl_from = 0;
+    }
+
+    if (E.current_buf->disk_changed && E.last_key != CTRL_KEY('S')) {
+        editor_set_message("%s changed on disk! Press CTRL-S again to overwrite it", E.current_buf->filename);
+        return;
     }
 
     size_t bytes_written;
@@ -124,3 +262,455 @@ void command_save_buffer(void) {
     else
         editor_set_message("Write error %d: %s", errcode, strerror(errno));
 }
+
+void command_reload_buffer(void) {
+    struct buffer *buffer = E.current_buf;
+
+    if (buffer->filename == NULL) {
+        editor_set_message("Nothing to reload, the buffer has no file on disk");
+        return;
+    }
+
+    if (buffer->modified && E.last_key != CTRL_KEY('R')) {
+        editor_set_message("Unsaved changes will be lost! Press CTRL-R again to reload");
+        return;
+    }
+
+    int n_changed, n_hunks;
+    if (buffer_reload_file(buffer, &n_changed, &n_hunks) == 0) {
+        cursor_move(buffer, 0, 0);
+        editor_set_message("Reloaded %s, %d line(s) changed in %d place(s)", buffer->filename, n_changed, n_hunks);
+    } else editor_set_message("Reload error: %s", strerror(errno));
+}
+
+void command_undo(void) {
+    ERRCODE errcode = undo_step_back(E.current_buf->undo, E.current_buf);
+
+    if (errcode == -1) editor_set_message("Nothing to undo");
+    else if (errcode == -3) editor_set_message("Still loading, can't undo that yet");
+    else if (errcode) editor_set_message("Memory limit of %zu MiB reached, undo history dropped", E.mem_limit >> 20);
+}
+
+void command_redo(void) {
+    ERRCODE errcode = undo_step_forward(E.current_buf->undo, E.current_buf);
+
+    if (errcode == -1) editor_set_message("Nothing to redo");
+    else if (errcode == -3) editor_set_message("Still loading, can't redo that yet");
+    else if (errcode) editor_set_message("Memory limit of %zu MiB reached, undo history dropped", E.mem_limit >> 20);
+}
+
+void command_toggle_follow(void) {
+    struct buffer *buffer = E.current_buf;
+
+    if (buffer->filename == NULL || buffer->watch == NULL) {
+        editor_set_message("Nothing to follow, the buffer has no file on disk");
+        return;
+    }
+
+    buffer->follow = !buffer->follow;
+
+    if (buffer->follow) {
+        buffer->stale = true;
+        cursor_move(buffer, 0, buffer->n_rows - buffer->cy);
+        editor_set_message("Following %s", buffer->filename);
+    } else editor_set_message("Stopped following %s", buffer->filename);
+}
+
+void command_record_macro(void) {
+    if (E.macro->recording) {
+        macro_stop(E.macro);
+        editor_set_message("Recorded a macro of %d key(s), CTRL-G replays it", E.macro->n_keys);
+    } else {
+        macro_start(E.macro);
+        editor_set_message("Recording a macro, CTRL-W again to stop");
+    }
+}
+
+void command_replay_macro(void) {
+    if (E.macro->recording || E.macro->n_keys == 0) {
+        editor_set_message(E.macro->recording ? "Stop recording before replaying" : "No macro recorded");
+        return;
+    }
+
+    char *answer = editor_prompt("Replay the macro how many times? %s", false);
+    if (answer == NULL)
+        return;
+
+    char *end;
+    long n_times = strtol(answer, &end, 10);
+    bool valid = *end == '\0' && n_times > 0 && n_times <= INT_MAX;
+    free(answer);
+
+    if (!valid) {
+        editor_set_message("Not a number of times");
+        return;
+    }
+
+    int n_done = macro_replay(E.macro, E.current_buf, n_times);
+    if (n_done < n_times) editor_set_message("Macro cancelled after %d of %ld time(s)", n_done, n_times);
+    else editor_set_message("Replayed the macro %d time(s)", n_done);
+}
+
+void command_set_mark(void) {
+    struct buffer *buffer = E.current_buf;
+
+    if (buffer->mark == buffer->cy) {
+        buffer->mark = -1;
+        editor_set_message("Mark cleared");
+    } else {
+        buffer->mark = buffer->cy;
+        editor_set_message("Mark set at line %d, commands now act on the lines up to the cursor",
+                           buffer->cy + 1);
+    }
+}
+
+// Replaces the marked lines, or the whole buffer, with what a shell command
+// prints when given them
+void command_filter(void) {
+    struct buffer *buffer = E.current_buf;
+
+    if (buffer_is_loading(buffer)) {
+        editor_set_message("Can't filter while the file is still loading");
+        return;
+    }
+
+    int from, to;
+    command_get_range(&from, &to);
+
+    char *command = editor_prompt("Filter through: %s", false);
+    if (command == NULL)
+        return;
+
+    struct erow **rows;
+    int n_rows, status;
+    ERRCODE errcode = filter_run(buffer, from, to, command, &rows, &n_rows, &status);
+    free(command);
+
+    if (errcode == -2) {
+        editor_set_message("Filter cancelled, nothing was changed");
+    } else if (errcode == -3) {
+        if (WIFEXITED(status))
+            editor_set_message("The command exited with status %d, nothing was changed", WEXITSTATUS(status));
+        else editor_set_message("The command was killed, nothing was changed");
+    } else if (errcode) {
+        editor_set_message("Can't run the command: %s", strerror(errno));
+    } else {
+        buffer_begin(buffer);
+        bool replaced = buffer_replace_rows(buffer, from, to - from, rows, n_rows);
+        buffer->mark = -1;
+        buffer_commit(buffer, 0, from);
+
+        if (replaced) editor_set_message("Replaced %d line(s) with %d", to - from, n_rows);
+        else editor_set_message("Memory limit of %zu MiB reached partway, undo to get the lines back",
+                                E.mem_limit >> 20);
+    }
+
+    free(rows);
+}
+
+// Sorts, reverses or drops repeated lines among the marked lines, or the
+// whole buffer, by moving rows around rather than their text
+void command_reorder(void) {
+    struct buffer *buffer = E.current_buf;
+
+    if (buffer_is_loading(buffer)) {
+        editor_set_message("Can't do that while the file is still loading");
+        return;
+    }
+    if (buffer->pager) {
+        editor_set_message("Too big to reorder in memory, filter it through sort(1) with CTRL-P instead");
+        return;
+    }
+
+    char *command = editor_prompt("Command (sort, reverse, uniq): %s", false);
+    if (command == NULL)
+        return;
+
+    enum { SORT, REVERSE, UNIQ } op;
+    if (strcmp(command, "sort") == 0) op = SORT;
+    else if (strcmp(command, "reverse") == 0) op = REVERSE;
+    else if (strcmp(command, "uniq") == 0) op = UNIQ;
+    else {
+        editor_set_message("Unknown command '%s'", command);
+        free(command);
+        return;
+    }
+    free(command);
+
+    int from, to;
+    command_get_range(&from, &to);
+
+    int n_old = to - from, n_new = n_old;
+    struct erow **rows = malloc(sizeof(struct erow *) * MAX(n_old, 1));
+    struct erow **dropped = NULL;
+
+    // Compressed rows are copied out of their blocks first
+    for (int i = 0; i < n_old; i++)
+        rows[i] = buffer_edit_row(buffer, from + i);
+
+    if (op == SORT) {
+        sort_rows(rows, n_old);
+    } else if (op == REVERSE) {
+        sort_reverse(rows, n_old);
+    } else {
+        dropped = malloc(sizeof(struct erow *) * MAX(n_old, 1));
+        n_new = sort_unique(rows, n_old, dropped);
+    }
+
+    buffer_begin(buffer);
+    buffer_reorder_rows(buffer, from, n_old, rows, n_new);
+    buffer->mark = -1;
+    buffer_commit(buffer, 0, from);
+
+    for (int i = 0; i < n_old - n_new; i++)
+        erow_free(dropped[i]);
+
+    if (op == UNIQ) editor_set_message("Dropped %d repeated line(s)", n_old - n_new);
+    else editor_set_message("Reordered %d line(s)", n_old);
+
+    free(rows);
+    free(dropped);
+}
+
+// Replaces every match among the marked lines, or in the whole buffer, in one
+// step that is undone at once
+void command_replace(void) {
+    struct buffer *buffer = E.current_buf;
+
+    if (buffer_is_loading(buffer)) {
+        editor_set_message("Can't do that while the file is still loading");
+        return;
+    }
+    if (buffer->pager) {
+        editor_set_message("Too big to replace in memory, filter it through sed(1) with CTRL-P instead");
+        return;
+    }
+
+    char *pattern = editor_prompt("Replace: %s", false);
+    if (pattern == NULL)
+        return;
+
+    // Nothing given deletes the matches
+    char *with = editor_prompt("With: %s (ESC to cancel)", true);
+    if (with == NULL) {
+        free(pattern);
+        return;
+    }
+
+    int from, to, n_changed;
+    command_get_range(&from, &to);
+
+    buffer_begin(buffer);
+    size_t n_replaced = replace_all(buffer, from, to, pattern, with, &n_changed);
+    buffer->mark = -1;
+    buffer_commit(buffer, buffer->cx, buffer->cy);
+
+    editor_set_message("Replaced %zu match(es) in %d line(s)", n_replaced, n_changed);
+
+    free(pattern);
+    free(with);
+}
+
+// Completes the word before the cursor from the words in the buffer. Pressing
+// again right away swaps in the next candidate.
+void command_complete(void) {
+    static struct buffer *last_buffer;
+    static int last_cx, last_cy, from, n_prefix, n_inserted, skip;
+
+    struct buffer *buffer = E.current_buf;
+    if (buffer->words == NULL) {
+        editor_set_message("No completion for files this big");
+        return;
+    }
+
+    struct erow *erow = buffer_get_crow(buffer);
+    if (erow == NULL)
+        return;
+
+    bool again = E.last_key == CTRL_KEY('N') && last_buffer == buffer &&
+                 last_cx == buffer->cx && last_cy == buffer->cy;
+
+    if (again) {
+        skip++;
+    } else {
+        from = buffer->cx;
+        while (from > 0 && words_is_char(erow->chars[from - 1]))
+            from--;
+
+        n_prefix = buffer->cx - from;
+        n_inserted = skip = 0;
+    }
+
+    if (n_prefix == 0) {
+        editor_set_message("No word to complete");
+        return;
+    }
+
+    char match[WORDS_MAX_LEN];
+    int n_match = words_complete(buffer->words, erow->chars + from, n_prefix, skip, match);
+    if (n_match == -1 && skip > 0)
+        n_match = words_complete(buffer->words, erow->chars + from, n_prefix, skip = 0, match);
+
+    if (n_match == -1) {
+        editor_set_message("No completions");
+        return;
+    }
+
+    if ((erow = command_edit_row(buffer->cy)) == NULL)
+        return;
+
+    buffer_begin(buffer);
+    erow_delete_chars(erow, n_inserted, from + n_prefix);
+    erow_insert_chars(erow, match + n_prefix, n_match - n_prefix, from + n_prefix);
+    buffer_commit(buffer, from + n_match, buffer->cy);
+
+    n_inserted = n_match - n_prefix;
+    last_buffer = buffer;
+    last_cx = buffer->cx, last_cy = buffer->cy;
+}
+
+// The marked lines, or the cursor line, for the kill ring. Compressed rows
+// are copied out of their blocks, NULL if there are no lines.
+static struct erow **command_kill_rows(int *from, int *n_rows) {
+    struct buffer *buffer = E.current_buf;
+
+    if (buffer->pager) {
+        editor_set_message("Too big to cut and paste lines in");
+        return NULL;
+    }
+
+    int to;
+    command_get_range(from, &to);
+    if (buffer->mark == -1)
+        to = MIN(buffer->cy + 1, buffer->n_rows), *from = MIN(buffer->cy, to);
+
+    *n_rows = to - *from;
+    if (*n_rows == 0)
+        return NULL;
+
+    struct erow **rows = malloc(sizeof(struct erow *) * *n_rows);
+    for (int i = 0; i < *n_rows; i++)
+        rows[i] = buffer_edit_row(buffer, *from + i);
+
+    return rows;
+}
+
+void command_cut(void) {
+    struct buffer *buffer = E.current_buf;
+
+    int from, n_rows;
+    struct erow **rows = command_kill_rows(&from, &n_rows);
+    if (rows == NULL)
+        return;
+
+    buffer_begin(buffer);
+    buffer_reorder_rows(buffer, from, n_rows, NULL, 0);
+    buffer->mark = -1;
+    buffer_commit(buffer, 0, from);
+
+    killring_push(E.kill_ring, rows, n_rows);
+    editor_set_message("Cut %d line(s)", n_rows);
+}
+
+void command_copy(void) {
+    struct buffer *buffer = E.current_buf;
+
+    int from, n_rows;
+    struct erow **rows = command_kill_rows(&from, &n_rows);
+    if (rows == NULL)
+        return;
+
+    for (int i = 0; i < n_rows; i++)
+        rows[i] = killring_clone(rows[i], buffer);
+
+    buffer->mark = -1;
+    killring_push(E.kill_ring, rows, n_rows);
+    editor_set_message("Copied %d line(s)", n_rows);
+}
+
+// Puts the last lines cut or copied above the cursor line. Pressing again
+// right away swaps them for the ones before.
+void command_paste(void) {
+    static struct buffer *last_buffer;
+    static int last_cy, at, n_pasted, age;
+
+    struct buffer *buffer = E.current_buf;
+    if (buffer->pager) {
+        editor_set_message("Too big to cut and paste lines in");
+        return;
+    }
+    if (!command_check_loaded())
+        return;
+
+    bool again = E.last_key == CTRL_KEY('V') && last_buffer == buffer && last_cy == buffer->cy;
+    if (again) {
+        age++;
+    } else {
+        at = buffer->cy;
+        n_pasted = age = 0;
+    }
+
+    int n_rows;
+    struct erow **rows = killring_paste(E.kill_ring, age, buffer, &n_rows);
+    if (rows == NULL && age > 0)
+        rows = killring_paste(E.kill_ring, age = 0, buffer, &n_rows);
+
+    if (rows == NULL) {
+        editor_set_message("Nothing to paste, cut or copy lines first");
+        return;
+    }
+
+    buffer_begin(buffer);
+    buffer_replace_rows(buffer, at, n_pasted, rows, n_rows);
+    buffer_commit(buffer, 0, at + n_rows);
+
+    n_pasted = n_rows;
+    last_buffer = buffer;
+    last_cy = buffer->cy;
+
+    editor_set_message("Pasted %d line(s)", n_rows);
+    free(rows);
+}
+
+void command_next_buffer(void) {
+    if (E.n_buffers == 1) {
+        editor_set_message("No other files open, list them all when starting kilo");
+        return;
+    }
+
+    editor_switch_buffer((E.buffer_at + 1) % E.n_buffers);
+    editor_set_message("%s", E.current_buf->filename);
+}
+
+// Memory used by the current buffer, pressing again switches to the whole
+// process and back. Sizes are in KiB, counts are allocations/frees followed
+// by reallocations.
+void command_stats(void) {
+    static bool process;
+    process = E.last_key == CTRL_KEY('U') && !process;
+
+    struct buffer_stats stats;
+
+    if (!process) {
+        stats_buffer(E.current_buf, &stats);
+        editor_set_message("rows %d/%d, chars %zuK, rchars %zuK, overhead %zuK, allocs %zu/%zu+%zu",
+                           stats.n_rows, stats.rows_cap, stats.n_bytes_chars >> 10,
+                           stats.n_bytes_rchars >> 10, stats.n_bytes_overhead >> 10,
+                           stats.n_allocs, stats.n_frees, stats.n_reallocs);
+        return;
+    }
+
+    size_t n_bytes_chars = 0, n_allocs = 0, n_frees = 0, n_reallocs = 0;
+    for (int i = 0; i < E.n_buffers; i++) {
+        stats_buffer(E.buffers[i].buffer, &stats);
+
+        n_bytes_chars += stats.n_bytes_chars;
+        n_allocs += stats.n_allocs;
+        n_frees += stats.n_frees;
+        n_reallocs += stats.n_reallocs;
+    }
+
+    editor_set_message("rss %zuK, %d file(s), chars %zuK, allocs %zu/%zu+%zu, drawing %zu/%zu+%zu",
+                       stats_rss() >> 10, E.n_buffers, n_bytes_chars >> 10,
+                       n_allocs, n_frees, n_reallocs, ab_n_allocs, ab_n_frees, ab_n_reallocs);
+}
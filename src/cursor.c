@@ -6,9 +6,10 @@
 
 static void cursor_adjust_viewport(struct buffer *buffer);
 
-void cursor_move(struct buffer *buffer, int dx, int dy) {
-    static int saved_rx = 0;
+// The column vertical moves try to keep to
+static int saved_rx = 0;
 
+void cursor_move(struct buffer *buffer, int dx, int dy) {
     buffer->cy = CLAMP(buffer->cy + dy, 0, buffer->n_rows);
 
     if (dx == 0)
@@ -34,6 +35,20 @@ void cursor_move(struct buffer *buffer, int dx, int dy) {
         saved_rx = buffer->rx;
 }
 
+// Puts the cursor at cx in row cy, both clamped to what exists
+void cursor_set(struct buffer *buffer, int cx, int cy) {
+    cursor_place(buffer, cx, cy);
+    cursor_adjust_viewport(buffer);
+}
+
+// Same as cursor_set, but leaves the viewport where it is
+void cursor_place(struct buffer *buffer, int cx, int cy) {
+    buffer->cy = CLAMP(cy, 0, buffer->n_rows);
+    buffer->cx = CLAMP(cx, 0, (int) buffer_get_crow_len(buffer));
+
+    buffer->rx = saved_rx = erow_cx_to_rx(buffer_get_crow(buffer), buffer->cx);
+}
+
 static void cursor_adjust_viewport(struct buffer *buffer) {
     int min_row_off = buffer->cy - (E.screenrows - 1);
     int max_row_off = buffer->cy;
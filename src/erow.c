@@ -3,46 +3,127 @@
 #include <string.h>
 
 #include "buffer.h"
+#include "cold.h"
+#include "intern.h"
 #include "erow.h"
 #include "kilo.h"
+#include "slab.h"
 #include "utils.h"
+#include "words.h"
 
-static void erow_update_rchars(struct erow *erow);
+static void erow_update_rchars(struct erow *erow, struct slab *slab);
+static void erow_unshare(struct erow *erow);
+
+static struct slab *erow_slab(struct erow *erow) {
+    return erow->buffer ? erow->buffer->slab : NULL;
+}
+
+static struct words *erow_words(struct erow *erow) {
+    return erow->buffer ? erow->buffer->words : NULL;
+}
 
 struct erow *erow_create(const char* chars, size_t n_chars, struct buffer *buffer) {
-    struct erow *erow = malloc(sizeof(struct erow));
+    return erow_create_in(buffer ? buffer->slab : NULL, chars, n_chars, buffer);
+}
+
+// Rows built off the main thread come from a private slab, which must end up
+// merged into the buffer's before the row is edited or freed
+struct erow *erow_create_in(struct slab *slab, const char* chars, size_t n_chars, struct buffer *buffer) {
+    struct erow *erow = slab_alloc(slab, sizeof(struct erow));
 
-    erow->chars = malloc(n_chars);
+    erow->buffer = buffer;
+
+    erow->chars = slab_alloc(slab, n_chars);
     erow->n_chars = n_chars;
 
-    memcpy(erow->chars, chars, erow->n_chars);
+    if (n_chars)
+        memcpy(erow->chars, chars, erow->n_chars);
 
     erow->rchars = NULL;
-    erow_update_rchars(erow);
+    erow->n_rchars = 0;
+
+    erow->hl = NULL;
+    erow->hl_in = erow->hl_out = 0;
+    erow->cold = NULL;
+    erow->shared = NULL;
+
+    erow_update_rchars(erow, slab);
+
+    return erow;
+}
+
+// A row showing line's text, taking over a reference the caller holds
+struct erow *erow_create_shared(struct slab *slab, struct intern_line *line, struct buffer *buffer) {
+    struct erow *erow = slab_alloc(slab, sizeof(struct erow));
 
     erow->buffer = buffer;
 
+    erow->chars = line->chars;
+    erow->n_chars = line->n_chars;
+    erow->rchars = line->rchars;
+    erow->n_rchars = line->n_rchars;
+
+    erow->hl = NULL;
+    erow->hl_in = erow->hl_out = 0;
+    erow->hl_stale = true;
+
+    erow->cold = NULL;
+    erow->shared = line;
+
     return erow;
 }
 
 void erow_insert_chars(struct erow *erow, const char *chars, size_t n_chars, int at) {
-    erow->chars = realloc(erow->chars, erow->n_chars + n_chars);
+    if (n_chars == 0)
+        return;
+
+    if (erow->buffer)
+        buffer_track_row_edit(erow->buffer, erow, EDIT_INSERT_CHARS, at, chars, n_chars);
+
+    if (erow->shared)
+        erow_unshare(erow);
+
+    struct words *words = erow_words(erow);
+    if (words)
+        words_edit_begin(words, erow->chars, erow->n_chars, at, 0);
+
+    erow->chars = slab_realloc(erow_slab(erow), erow->chars, erow->n_chars, erow->n_chars + n_chars);
     memmove(erow->chars + at + n_chars, erow->chars + at, erow->n_chars - at);
     memcpy(erow->chars + at, chars, n_chars);
 
     erow->n_chars += n_chars;
 
-    erow_update_rchars(erow);
+    if (words)
+        words_edit_end(words, erow->chars, erow->n_chars, at, n_chars);
+
+    erow_update_rchars(erow, erow_slab(erow));
 
     if (erow->buffer)
         erow->buffer->modified = true;
 }
 
 void erow_delete_chars(struct erow *erow, size_t n_chars, int at) {
+    if (n_chars == 0)
+        return;
+
+    if (erow->buffer)
+        buffer_track_row_edit(erow->buffer, erow, EDIT_DELETE_CHARS, at, erow->chars + at, n_chars);
+
+    if (erow->shared)
+        erow_unshare(erow);
+
+    struct words *words = erow_words(erow);
+    if (words)
+        words_edit_begin(words, erow->chars, erow->n_chars, at, n_chars);
+
     memmove(erow->chars + at, erow->chars + at + n_chars, erow->n_chars - at - n_chars);
-    erow->chars = realloc(erow->chars, erow->n_chars -= n_chars);
+    erow->chars = slab_realloc(erow_slab(erow), erow->chars, erow->n_chars, erow->n_chars - n_chars);
+    erow->n_chars -= n_chars;
+
+    if (words)
+        words_edit_end(words, erow->chars, erow->n_chars, at, 0);
 
-    erow_update_rchars(erow);
+    erow_update_rchars(erow, erow_slab(erow));
 
     if (erow->buffer)
         erow->buffer->modified = true;
@@ -85,36 +166,74 @@ int erow_rx_to_cx(struct erow *erow, int rx) {
     return cx;
 }
 
-void erow_free(struct erow *erow) {
-    if (erow->chars) free(erow->chars);
-    if (erow->rchars) free(erow->rchars);
-}
+// Expands tabs in chars into rchars, or only counts with rchars NULL. Returns
+// the rendered length.
+size_t erow_render(const char *chars, size_t n_chars, char *rchars) {
+    size_t n_rchars = 0;
 
-static void erow_update_rchars(struct erow *erow) {
-    if (erow->rchars)
-        free(erow->rchars);
+    for (const char *c = chars; c < chars + n_chars; c++) {
+        if (*c == '\t') {
+            int spaces = KILO_TAB_STOP - (n_rchars % KILO_TAB_STOP);
 
-    size_t n_rchars_max = 16;
-    erow->rchars = malloc(n_rchars_max);
-    erow->n_rchars = 0;
+            if (rchars) memset(rchars + n_rchars, ' ', spaces);
+            n_rchars += spaces;
+        } else {
+            if (rchars) rchars[n_rchars] = *c;
+            n_rchars++;
+        }
+    }
 
-    for (char *c = erow->chars; c < erow->chars + erow->n_chars; c++) {
-        if (*c == '\t') {
-            int spaces = KILO_TAB_STOP - (erow->n_rchars % KILO_TAB_STOP);
+    return n_rchars;
+}
 
-            while (erow->n_rchars + spaces > n_rchars_max)
-                erow->rchars = realloc(erow->rchars, n_rchars_max *= 2);
+void erow_free(struct erow *erow) {
+    struct slab *slab = erow_slab(erow);
 
-            memset(erow->rchars + erow->n_rchars, ' ', spaces);
-            erow->n_rchars += spaces;
-        } else {
-            if (erow->n_rchars + 1 > n_rchars_max)
-                erow->rchars = realloc(erow->rchars, n_rchars_max *= 2);
+    // The text of rows in a block belongs to the block
+    if (erow->cold) {
+        cold_detach(erow->buffer->cold, erow);
+        slab_dealloc(slab, erow, sizeof(struct erow));
+        return;
+    }
 
-            erow->rchars[erow->n_rchars++] = *c;
-        }
+    if (erow->shared) {
+        intern_release(erow->buffer->intern, erow->shared, slab);
+        slab_dealloc(slab, erow->hl, erow->n_rchars);
+        slab_dealloc(slab, erow, sizeof(struct erow));
+        return;
     }
 
-    erow->rchars = realloc(erow->rchars, erow->n_rchars);
+    slab_dealloc(slab, erow->chars, erow->n_chars);
+    slab_dealloc(slab, erow->rchars, erow->n_rchars);
+    slab_dealloc(slab, erow->hl, erow->n_rchars);
+    slab_dealloc(slab, erow, sizeof(struct erow));
+}
+
+// slab is where the row was allocated, which for rows still being built is
+// not necessarily their buffer's
+static void erow_update_rchars(struct erow *erow, struct slab *slab) {
+    size_t n_rchars = erow_render(erow->chars, erow->n_chars, NULL);
+
+    // The highlighting no longer matches, it is redone when next drawn
+    slab_dealloc(slab, erow->hl, erow->n_rchars);
+    erow->hl = NULL;
+    erow->hl_stale = true;
+
+    erow->rchars = slab_realloc(slab, erow->rchars, erow->n_rchars, n_rchars);
+    erow->n_rchars = erow_render(erow->chars, erow->n_chars, erow->rchars);
 }
 
+// Copy on write, the shared text stays as it is for the other rows
+static void erow_unshare(struct erow *erow) {
+    struct slab *slab = erow_slab(erow);
+
+    char *chars = slab_alloc(slab, erow->n_chars), *rchars = slab_alloc(slab, erow->n_rchars);
+    if (erow->n_chars) memcpy(chars, erow->chars, erow->n_chars);
+    if (erow->n_rchars) memcpy(rchars, erow->rchars, erow->n_rchars);
+
+    intern_release(erow->buffer->intern, erow->shared, slab);
+
+    erow->chars = chars;
+    erow->rchars = rchars;
+    erow->shared = NULL;
+}
@@ -0,0 +1,257 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "erow.h"
+#include "filter.h"
+#include "kilo.h"
+#include "utils.h"
+
+#define FILTER_BLOCK_SIZE (64 * 1024)
+
+struct filter {
+    struct buffer *buffer;
+    int to_child, from_child;
+
+    // Rows still to send, a block's worth at a time
+    int next_row, end_row;
+    char *out;
+    size_t out_cap, n_out, out_at;
+
+    // What came back, the last line possibly still incomplete
+    struct erow **rows;
+    int n_rows, rows_cap;
+    char *line;
+    size_t line_cap, line_len;
+};
+
+static pid_t filter_spawn(const char *command, int *to_child, int *from_child);
+static void filter_send(struct filter *filter);
+static void filter_receive(struct filter *filter, const char *block, size_t n_read);
+static void filter_add_row(struct filter *filter, const char *chars, size_t n_chars);
+
+// Runs command with rows from..to-1 on its standard input and reads back
+// what it writes as new rows. Both sides are streamed through non-blocking
+// pipes, so neither the rows sent nor the output are ever held as a whole.
+// The rows are only handed back if the command succeeded.
+ERRCODE filter_run(struct buffer *buffer, int from, int to, const char *command,
+                   struct erow ***rows, int *n_rows, int *status) {
+    ERRCODE errcode = 0;
+
+    // A command that stops reading early must not take the editor down
+    struct sigaction ignore = { 0 }, saved;
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore, &saved);
+
+    struct filter filter = { 0 };
+    filter.buffer = buffer;
+    filter.next_row = from;
+    filter.end_row = to;
+    filter.out = malloc(filter.out_cap = FILTER_BLOCK_SIZE);
+    filter.line = malloc(filter.line_cap = 256);
+
+    char *block = malloc(FILTER_BLOCK_SIZE);
+    int64_t shown_at = utils_now();
+
+    pid_t pid = filter_spawn(command, &filter.to_child, &filter.from_child);
+    if (pid == -1)
+        RETURN(-1);
+
+    while (filter.from_child != -1) {
+        struct pollfd fds[2] = {
+            { filter.to_child, POLLOUT, 0 },
+            { filter.from_child, POLLIN, 0 },
+        };
+
+        if (poll(fds, 2, 100) == -1 && errno != EINTR)
+            break;
+
+        if (filter.to_child != -1 && fds[0].revents)
+            filter_send(&filter);
+
+        if (fds[1].revents) {
+            ssize_t n_read = read(filter.from_child, block, FILTER_BLOCK_SIZE);
+
+            if (n_read > 0) {
+                filter_receive(&filter, block, n_read);
+            } else if (n_read == 0 || (errno != EAGAIN && errno != EINTR)) {
+                close(filter.from_child);
+                filter.from_child = -1;
+            }
+        }
+
+        if (utils_progress(&shown_at, "Filtering, %d of %d line(s) sent, %d back (any key cancels)",
+                           filter.next_row - from, to - from, filter.n_rows)) {
+            kill(pid, SIGTERM);
+            errcode = -2;
+            break;
+        }
+    }
+
+    if (filter.line_len)
+        filter_add_row(&filter, filter.line, filter.line_len);
+
+    if (filter.to_child != -1) close(filter.to_child);
+    if (filter.from_child != -1) close(filter.from_child);
+
+    while (waitpid(pid, status, 0) == -1 && errno == EINTR);
+
+    if (errcode == 0 && !(WIFEXITED(*status) && WEXITSTATUS(*status) == 0))
+        RETURN(-3);
+
+    *status = 0;
+
+END:
+    if (errcode) {
+        for (int i = 0; i < filter.n_rows; i++)
+            erow_free(filter.rows[i]);
+
+        free(filter.rows);
+        filter.rows = NULL;
+        filter.n_rows = 0;
+    }
+
+    *rows = filter.rows;
+    *n_rows = filter.n_rows;
+
+    free(block);
+    free(filter.line);
+    free(filter.out);
+
+    sigaction(SIGPIPE, &saved, NULL);
+
+    return errcode;
+}
+
+/*****************************************************************************/
+
+static pid_t filter_spawn(const char *command, int *to_child, int *from_child) {
+    int in[2], out[2];
+
+    if (pipe(in) == -1)
+        return -1;
+
+    if (pipe(out) == -1) {
+        close(in[0]);
+        close(in[1]);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        struct sigaction dfl = { 0 };
+        dfl.sa_handler = SIG_DFL;
+        sigaction(SIGPIPE, &dfl, NULL);
+
+        int null = open("/dev/null", O_WRONLY);
+
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        if (null != -1)
+            dup2(null, STDERR_FILENO);
+
+        close(in[0]);
+        close(in[1]);
+        close(out[0]);
+        close(out[1]);
+
+        execl("/bin/sh", "sh", "-c", command, (char *) NULL);
+        _exit(127);
+    }
+
+    close(in[0]);
+    close(out[1]);
+
+    if (pid == -1) {
+        close(in[1]);
+        close(out[0]);
+        return -1;
+    }
+
+    *to_child = in[1];
+    *from_child = out[0];
+
+    fcntl(*to_child, F_SETFL, fcntl(*to_child, F_GETFL) | O_NONBLOCK);
+    fcntl(*from_child, F_SETFL, fcntl(*from_child, F_GETFL) | O_NONBLOCK);
+
+    return pid;
+}
+
+// Writes as much as the pipe takes, refilling from the rows when drained
+static void filter_send(struct filter *filter) {
+    if (filter->out_at == filter->n_out) {
+        filter->n_out = filter->out_at = 0;
+
+        while (filter->next_row < filter->end_row && filter->n_out < FILTER_BLOCK_SIZE) {
+            struct erow *erow = buffer_get_row(filter->buffer, filter->next_row++);
+
+            if (filter->n_out + erow->n_chars + 1 > filter->out_cap) {
+                filter->out_cap = filter->n_out + erow->n_chars + 1;
+                filter->out = realloc(filter->out, filter->out_cap);
+            }
+
+            memcpy(filter->out + filter->n_out, erow->chars, erow->n_chars);
+            filter->n_out += erow->n_chars;
+            filter->out[filter->n_out++] = '\n';
+        }
+    }
+
+    ssize_t n_written = 0;
+    if (filter->out_at < filter->n_out)
+        n_written = write(filter->to_child, filter->out + filter->out_at, filter->n_out - filter->out_at);
+
+    if (n_written > 0)
+        filter->out_at += n_written;
+
+    // Everything is sent, or the command doesn't want any more
+    bool done = filter->out_at == filter->n_out && filter->next_row == filter->end_row;
+    if (done || (n_written == -1 && errno != EAGAIN && errno != EINTR)) {
+        close(filter->to_child);
+        filter->to_child = -1;
+    }
+}
+
+static void filter_receive(struct filter *filter, const char *block, size_t n_read) {
+    for (const char *c = block, *end = block + n_read; c < end;) {
+        const char *newline = memchr(c, '\n', end - c);
+        const char *line_end = newline ? newline : end;
+
+        if (filter->line_len || newline == NULL) {
+            size_t n_chars = line_end - c;
+            while (filter->line_len + n_chars > filter->line_cap)
+                filter->line = realloc(filter->line, filter->line_cap *= 2);
+
+            memcpy(filter->line + filter->line_len, c, n_chars);
+            filter->line_len += n_chars;
+        }
+
+        if (newline == NULL)
+            break;
+
+        if (filter->line_len) {
+            filter_add_row(filter, filter->line, filter->line_len);
+            filter->line_len = 0;
+        } else filter_add_row(filter, c, newline - c);
+
+        c = newline + 1;
+    }
+}
+
+static void filter_add_row(struct filter *filter, const char *chars, size_t n_chars) {
+    if (filter->n_rows == filter->rows_cap) {
+        filter->rows_cap = MAX(filter->rows_cap * 2, 64);
+        filter->rows = realloc(filter->rows, sizeof(struct erow *) * filter->rows_cap);
+    }
+
+    filter->rows[filter->n_rows++] = erow_create(chars, n_chars, filter->buffer);
+}
@@ -0,0 +1,217 @@
+#define _XOPEN_SOURCE 700
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "idxcache.h"
+#include "pager.h"
+#include "utils.h"
+
+#ifdef __APPLE__
+#define st_mtim st_mtimespec
+#endif
+
+#define IDXCACHE_MAGIC "KILOIDX1"
+
+struct idxcache_header {
+    char magic[8];
+    uint64_t extent_size;
+
+    uint64_t size, ino, dev;
+    int64_t mtime_sec, mtime_nsec;
+
+    uint64_t n_extents;
+    uint64_t path_len;
+};
+
+// Padded so that the extents following the path stay aligned
+static size_t idxcache_path_size(size_t path_len) {
+    return (path_len + 7) & ~(size_t) 7;
+}
+
+static void idxcache_fill_header(struct idxcache_header *header, struct stat *st) {
+    memset(header, 0, sizeof(struct idxcache_header));
+    memcpy(header->magic, IDXCACHE_MAGIC, sizeof(header->magic));
+    header->extent_size = sizeof(struct page_extent);
+
+    header->size = st->st_size;
+    header->ino = st->st_ino;
+    header->dev = st->st_dev;
+    header->mtime_sec = st->st_mtim.tv_sec;
+    header->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+// Returns the cache file for filename and its resolved path, or NULL if there
+// is nowhere to put it. With create set, the cache directory is made too.
+static char *idxcache_path(const char *filename, char **real_path, bool create) {
+    char dir[PATH_MAX];
+    const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+
+    if (xdg && *xdg) snprintf(dir, sizeof(dir), "%s/kilo", xdg);
+    else if (home && *home) snprintf(dir, sizeof(dir), "%s/.cache/kilo", home);
+    else return NULL;
+
+    if (create) {
+        char *slash = strrchr(dir, '/');
+        *slash = '\0';
+        mkdir(dir, 0755);
+        *slash = '/';
+
+        mkdir(dir, 0755);
+    }
+
+    *real_path = realpath(filename, NULL);
+    if (*real_path == NULL)
+        return NULL;
+
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (char *c = *real_path; *c; c++)
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+
+    size_t len = strlen(dir) + 22;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/%016llx.idx", dir, (unsigned long long) hash);
+
+    return path;
+}
+
+ERRCODE idxcache_load(const char *filename, struct pager *pager) {
+    ERRCODE errcode = 0;
+
+    char *real_path = NULL;
+    char *path = idxcache_path(filename, &real_path, false);
+    void *map = MAP_FAILED;
+    size_t map_size = 0;
+    int fd = -1;
+
+    if (path == NULL)
+        RETURN(-1);
+
+    struct stat st, cache_st;
+    if (fstat(pager->fd, &st) == -1)
+        RETURN(-1);
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &cache_st) == -1)
+        RETURN(-2);
+
+    map_size = cache_st.st_size;
+    if (map_size < sizeof(struct idxcache_header))
+        RETURN(-3);
+
+    // Safe to map, unlike the files being edited: caches are only ever written
+    // under a temporary name and renamed over this one, so the file mapped
+    // here is never truncated under us
+    map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+        RETURN(-3);
+
+    struct idxcache_header *header = map, expected;
+    idxcache_fill_header(&expected, &st);
+
+    size_t path_len = strlen(real_path);
+    if (memcmp(header->magic, expected.magic, sizeof(header->magic)) != 0
+        || header->extent_size != expected.extent_size
+        || header->size != expected.size || header->ino != expected.ino || header->dev != expected.dev
+        || header->mtime_sec != expected.mtime_sec || header->mtime_nsec != expected.mtime_nsec
+        || header->path_len != path_len)
+        RETURN(-4);
+
+    size_t extents_at = sizeof(struct idxcache_header) + idxcache_path_size(path_len);
+    if (map_size != extents_at + header->n_extents * sizeof(struct page_extent)
+        || memcmp((char *) map + sizeof(struct idxcache_header), real_path, path_len) != 0)
+        RETURN(-4);
+
+    struct page_extent *extents = (struct page_extent *) ((char *) map + extents_at);
+
+    uint64_t n_bytes = 0;
+    for (uint64_t i = 0; i < header->n_extents; i++)
+        n_bytes += extents[i].n_bytes;
+
+    if (n_bytes != header->size)
+        RETURN(-4);
+
+    pager_append(pager, extents, header->n_extents);
+
+END:
+    if (map != MAP_FAILED)
+        munmap(map, map_size);
+
+    if (fd != -1)
+        close(fd);
+
+    free(path);
+    free(real_path);
+
+    return errcode;
+}
+
+ERRCODE idxcache_store(const char *filename, struct pager *pager) {
+    ERRCODE errcode = 0;
+
+    char *real_path = NULL;
+    char *path = idxcache_path(filename, &real_path, true);
+    char *tmp_path = NULL;
+    FILE *file = NULL;
+
+    if (path == NULL)
+        RETURN(-1);
+
+    struct stat st;
+    if (fstat(pager->fd, &st) == -1)
+        RETURN(-1);
+
+    struct idxcache_header header;
+    idxcache_fill_header(&header, &st);
+    header.n_extents = pager->n_pages;
+    header.path_len = strlen(real_path);
+
+    size_t tmp_len = strlen(path) + 5;
+    tmp_path = malloc(tmp_len);
+    snprintf(tmp_path, tmp_len, "%s.tmp", path);
+
+    file = fopen(tmp_path, "w");
+    if (file == NULL)
+        RETURN(-2);
+
+    static const char padding[8] = { 0 };
+    size_t path_size = idxcache_path_size(header.path_len);
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(real_path, 1, header.path_len, file) == header.path_len
+        && fwrite(padding, 1, path_size - header.path_len, file) == path_size - header.path_len;
+
+    for (int p = 0; ok && p < pager->n_pages; p++)
+        ok = fwrite(&pager->pages[p].extent, sizeof(struct page_extent), 1, file) == 1;
+
+    if (fclose(file) != 0 || !ok) {
+        file = NULL;
+        unlink(tmp_path);
+        RETURN(-3);
+    }
+    file = NULL;
+
+    if (rename(tmp_path, path) == -1) {
+        unlink(tmp_path);
+        RETURN(-4);
+    }
+
+END:
+    if (file != NULL)
+        fclose(file);
+
+    free(tmp_path);
+    free(path);
+    free(real_path);
+
+    return errcode;
+}
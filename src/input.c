@@ -1,6 +1,11 @@
+#include <stdbool.h>
+
 #include "commands.h"
 #include "input.h"
 #include "kilo.h"
+#include "macro.h"
+
+static bool input_recordable(KEY c);
 
 void input_process_key(KEY c) {
     switch (c) {
@@ -19,13 +24,78 @@ void input_process_key(KEY c) {
             command_save_buffer();
             break;
 
+        case CTRL_KEY('R'):
+            command_reload_buffer();
+            break;
+
+        case CTRL_KEY('Z'):
+            command_undo();
+            break;
+
+        case CTRL_KEY('Y'):
+            command_redo();
+            break;
+
+        case CTRL_KEY('T'):
+            command_toggle_follow();
+            break;
+
+        case CTRL_KEY('W'):
+            command_record_macro();
+            break;
+
+        case CTRL_KEY('G'):
+            command_replay_macro();
+            break;
+
+        case CTRL_KEY('B'):
+            command_set_mark();
+            break;
+
+        case CTRL_KEY('P'):
+            command_filter();
+            break;
+
+        case CTRL_KEY('E'):
+            command_reorder();
+            break;
+
+        case CTRL_KEY('F'):
+            command_replace();
+            break;
+
+        case CTRL_KEY('N'):
+            command_complete();
+            break;
+
+        case CTRL_KEY('X'):
+            command_cut();
+            break;
+
+        case CTRL_KEY('C'):
+            command_copy();
+            break;
+
+        case CTRL_KEY('V'):
+            command_paste();
+            break;
+
+        case CTRL_KEY('O'):
+            command_next_buffer();
+            break;
+
+        case CTRL_KEY('U'):
+            command_stats();
+            break;
+
         case ENTER:
             command_insert_line();
             break;
 
         case DEL:
-            input_process_key(ARROW_RIGHT);
-            // fall through
+            command_delete_next_char();
+            break;
+
         case BACKSPACE:
         case CTRL_KEY('H'):
             command_delete_char();
@@ -46,4 +116,39 @@ void input_process_key(KEY c) {
     }
 
     E.quit_times = 3;
+
+    if (input_recordable(c))
+        macro_record(E.macro, c);
+
+    // Lets commands ask for a second press to confirm
+    if (c != NOP)
+        E.last_key = c;
+}
+
+/*****************************************************************************/
+
+// Macros hold edits and moves only. Replaying one is already a single undo
+// step, files are saved, reloaded or switched by hand, and nothing that
+// prompts would work while replaying.
+static bool input_recordable(KEY c) {
+    switch (c) {
+        case CTRL_KEY('S'):
+        case CTRL_KEY('R'):
+        case CTRL_KEY('Z'):
+        case CTRL_KEY('Y'):
+        case CTRL_KEY('T'):
+        case CTRL_KEY('W'):
+        case CTRL_KEY('G'):
+        case CTRL_KEY('P'):
+        case CTRL_KEY('E'):
+        case CTRL_KEY('F'):
+        case CTRL_KEY('O'):
+        case CTRL_KEY('U'):
+        case CTRL_KEY('L'):
+        case ESCAPE:
+        case NOP:
+            return false;
+    }
+
+    return true;
 }
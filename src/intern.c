@@ -0,0 +1,220 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "erow.h"
+#include "intern.h"
+#include "slab.h"
+#include "utils.h"
+
+#define INTERN_MIN_BUCKETS 1024
+
+static uint32_t intern_hash(const char *chars, size_t n_chars);
+static struct intern_line *intern_find(struct intern *intern, const char *chars, size_t n_chars, uint32_t hash);
+static void intern_insert(struct intern *intern, struct intern_line *line);
+static void intern_line_free(struct intern_line *line, struct slab *slab);
+
+static size_t intern_line_size(const struct intern_line *line) {
+    return line->n_chars + line->n_rchars;
+}
+
+struct intern *intern_create(void) {
+    struct intern *intern = malloc(sizeof(struct intern));
+
+    intern->n_buckets = INTERN_MIN_BUCKETS;
+    intern->buckets = calloc(intern->n_buckets, sizeof(struct intern_line *));
+    intern->n_lines = 0;
+    intern->n_bytes_saved = 0;
+
+    return intern;
+}
+
+// Returns the line holding chars, made in slab if there is none yet, with a
+// reference taken for the caller
+struct intern_line *intern_get(struct intern *intern, struct slab *slab, const char *chars, size_t n_chars) {
+    uint32_t hash = intern_hash(chars, n_chars);
+
+    struct intern_line *line = intern_find(intern, chars, n_chars, hash);
+    if (line) {
+        line->refs++;
+        intern->n_bytes_saved += intern_line_size(line);
+        return line;
+    }
+
+    line = slab_alloc(slab, sizeof(struct intern_line));
+
+    line->chars = slab_alloc(slab, n_chars);
+    line->n_chars = n_chars;
+    if (n_chars)
+        memcpy(line->chars, chars, n_chars);
+
+    // Without tabs a line renders as itself
+    line->n_rchars = erow_render(chars, n_chars, NULL);
+    line->rchars = line->n_rchars == n_chars ? line->chars : slab_alloc(slab, line->n_rchars);
+    if (line->rchars != line->chars)
+        erow_render(chars, n_chars, line->rchars);
+
+    line->hash = hash;
+    line->refs = 1;
+    line->stored = line->forwarded = false;
+
+    intern_insert(intern, line);
+
+    return line;
+}
+
+// Takes the lines of freshly loaded rows into the store, pointing rows at
+// the stored copy where there already is one. slab is where the rows' lines
+// were made, and must be the one they are freed into.
+void intern_adopt(struct intern *intern, struct erow **rows, int n_rows, struct slab *slab) {
+    for (int i = 0; i < n_rows; i++) {
+        struct erow *erow = rows[i];
+        struct intern_line *line = erow->shared;
+
+        if (line == NULL || line->stored)
+            continue;
+
+        if (!line->forwarded) {
+            struct intern_line *stored = intern_find(intern, line->chars, line->n_chars, line->hash);
+
+            if (stored == NULL) {
+                intern_insert(intern, line);
+                line->stored = true;
+                intern->n_bytes_saved += (line->refs - 1) * intern_line_size(line);
+                continue;
+            }
+
+            line->next = stored;
+            line->forwarded = true;
+        }
+
+        struct intern_line *stored = line->next;
+        stored->refs++;
+        intern->n_bytes_saved += intern_line_size(stored);
+
+        erow->shared = stored;
+        erow->chars = stored->chars;
+        erow->rchars = stored->rchars;
+
+        if (--line->refs == 0)
+            intern_line_free(line, slab);
+    }
+}
+
+// Turns the row's own text into a line, without copying it, so that other
+// rows can show it too. Returns it with a reference taken for the caller.
+struct intern_line *intern_share(struct intern *intern, struct erow *erow, struct slab *slab) {
+    struct intern_line *line = erow->shared;
+
+    if (line) {
+        line->refs++;
+        if (line->stored)
+            intern->n_bytes_saved += intern_line_size(line);
+        return line;
+    }
+
+    line = slab_alloc(slab, sizeof(struct intern_line));
+
+    line->chars = erow->chars;
+    line->n_chars = erow->n_chars;
+    line->rchars = erow->rchars;
+    line->n_rchars = erow->n_rchars;
+
+    line->hash = 0;
+    line->refs = 2;
+    line->next = NULL;
+    line->stored = line->forwarded = false;
+
+    erow->shared = line;
+
+    return line;
+}
+
+// intern may be NULL for lines made by intern_share, which are in no store
+void intern_release(struct intern *intern, struct intern_line *line, struct slab *slab) {
+    if (--line->refs) {
+        if (line->stored)
+            intern->n_bytes_saved -= intern_line_size(line);
+        return;
+    }
+
+    if (line->stored) {
+        struct intern_line **link = &intern->buckets[line->hash & (intern->n_buckets - 1)];
+        while (*link != line)
+            link = &(*link)->next;
+
+        *link = line->next;
+        intern->n_lines--;
+    }
+
+    intern_line_free(line, slab);
+}
+
+// Forgets every line without touching them, once they have been handed on
+void intern_clear(struct intern *intern) {
+    memset(intern->buckets, 0, sizeof(struct intern_line *) * intern->n_buckets);
+    intern->n_lines = 0;
+    intern->n_bytes_saved = 0;
+}
+
+void intern_free(struct intern *intern) {
+    free(intern->buckets);
+    free(intern);
+}
+
+/*****************************************************************************/
+
+static uint32_t intern_hash(const char *chars, size_t n_chars) {
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < n_chars; i++)
+        hash = (hash ^ (unsigned char) chars[i]) * 16777619u;
+
+    return hash;
+}
+
+static struct intern_line *intern_find(struct intern *intern, const char *chars, size_t n_chars, uint32_t hash) {
+    struct intern_line *line = intern->buckets[hash & (intern->n_buckets - 1)];
+
+    for (; line; line = line->next) {
+        if (line->hash == hash && line->n_chars == n_chars && memcmp(line->chars, chars, n_chars) == 0)
+            return line;
+    }
+
+    return NULL;
+}
+
+static void intern_insert(struct intern *intern, struct intern_line *line) {
+    if (intern->n_lines == intern->n_buckets) {
+        size_t n_buckets = intern->n_buckets * 2;
+        struct intern_line **buckets = calloc(n_buckets, sizeof(struct intern_line *));
+
+        for (size_t i = 0; i < intern->n_buckets; i++) {
+            for (struct intern_line *next, *moved = intern->buckets[i]; moved; moved = next) {
+                next = moved->next;
+
+                moved->next = buckets[moved->hash & (n_buckets - 1)];
+                buckets[moved->hash & (n_buckets - 1)] = moved;
+            }
+        }
+
+        free(intern->buckets);
+        intern->buckets = buckets;
+        intern->n_buckets = n_buckets;
+    }
+
+    struct intern_line **bucket = &intern->buckets[line->hash & (intern->n_buckets - 1)];
+    line->next = *bucket;
+    *bucket = line;
+
+    intern->n_lines++;
+}
+
+static void intern_line_free(struct intern_line *line, struct slab *slab) {
+    if (line->rchars != line->chars)
+        slab_dealloc(slab, line->rchars, line->n_rchars);
+
+    slab_dealloc(slab, line->chars, line->n_chars);
+    slab_dealloc(slab, line, sizeof(struct intern_line));
+}
@@ -0,0 +1,335 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "erow.h"
+#include "journal.h"
+#include "undo.h"
+#include "utils.h"
+
+#ifdef __APPLE__
+#define st_mtim st_mtimespec
+#endif
+
+#define JOURNAL_MAGIC "KILOJNL1"
+
+// Records are held back until the oldest is this old, or there are this many
+// bytes of them, and then written and synced together
+#define JOURNAL_COMMIT_NS 1000000000LL
+#define JOURNAL_COMMIT_BYTES (64 * 1024)
+
+struct journal_header {
+    char magic[8];
+
+    uint64_t size, ino, dev;
+    int64_t mtime_sec, mtime_nsec;
+};
+
+struct journal {
+    char *path;
+    int fd;
+
+    char *pending;
+    size_t n_pending, pending_cap;
+    int64_t pending_since;
+};
+
+static char *journal_path(const char *filename) {
+    const char *slash = strrchr(filename, '/');
+    const char *base = slash ? slash + 1 : filename;
+
+    size_t len = strlen(filename) + sizeof(".") + sizeof(".kilo-swap");
+    char *path = malloc(len);
+    snprintf(path, len, "%.*s.%s.kilo-swap", (int) (base - filename), filename, base);
+
+    return path;
+}
+
+static void journal_fill_header(struct journal_header *header, const struct stat *st) {
+    memset(header, 0, sizeof(struct journal_header));
+    memcpy(header->magic, JOURNAL_MAGIC, sizeof(header->magic));
+
+    header->size = st->st_size;
+    header->ino = st->st_ino;
+    header->dev = st->st_dev;
+    header->mtime_sec = st->st_mtim.tv_sec;
+    header->mtime_nsec = st->st_mtim.tv_nsec;
+}
+
+static bool journal_write_all(int fd, const char *chars, size_t n_chars) {
+    while (n_chars) {
+        ssize_t n_written = write(fd, chars, n_chars);
+        if (n_written == -1 && errno == EINTR)
+            continue;
+        if (n_written <= 0)
+            return false;
+
+        chars += n_written;
+        n_chars -= n_written;
+    }
+
+    return true;
+}
+
+static struct journal *journal_create(char *path, int fd) {
+    struct journal *journal = malloc(sizeof(struct journal));
+
+    journal->path = path;
+    journal->fd = fd;
+
+    journal->pending = NULL;
+    journal->n_pending = journal->pending_cap = 0;
+    journal->pending_since = 0;
+
+    return journal;
+}
+
+// Starts a new journal for edits to the file as described by file_stat,
+// replacing any old one. Returns NULL if it can't be written.
+struct journal *journal_open(const char *filename, const struct stat *file_stat) {
+    char *path = journal_path(filename);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+        free(path);
+        return NULL;
+    }
+
+    struct journal_header header;
+    journal_fill_header(&header, file_stat);
+
+    if (!journal_write_all(fd, (char *) &header, sizeof(header))) {
+        close(fd);
+        unlink(path);
+        free(path);
+        return NULL;
+    }
+
+    return journal_create(path, fd);
+}
+
+static size_t journal_put_varint(char *out, uint64_t value) {
+    size_t n = 0;
+
+    do {
+        out[n++] = (value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+        value >>= 7;
+    } while (value);
+
+    return n;
+}
+
+static bool journal_get_varint(const char **c, const char *end, uint64_t *value) {
+    *value = 0;
+
+    for (int shift = 0; *c < end && shift < 64; shift += 7) {
+        unsigned char byte = *(*c)++;
+        *value |= (uint64_t) (byte & 0x7f) << shift;
+
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+// A record is the edit type, row, at and n_chars as varints, followed by the
+// text for insertions
+void journal_record(struct journal *journal, const struct edit *edit) {
+    bool has_chars = edit->type == EDIT_INSERT_CHARS || edit->type == EDIT_INSERT_ROW;
+
+    char head[1 + 3 * 10];
+    size_t n_head = 0;
+
+    head[n_head++] = edit->type;
+    n_head += journal_put_varint(head + n_head, edit->row);
+    n_head += journal_put_varint(head + n_head, edit->at);
+    n_head += journal_put_varint(head + n_head, edit->n_chars);
+
+    size_t n_record = n_head + (has_chars ? edit->n_chars : 0);
+    if (journal->n_pending + n_record > journal->pending_cap) {
+        journal->pending_cap = MAX(journal->pending_cap * 2, journal->n_pending + n_record);
+        journal->pending = realloc(journal->pending, journal->pending_cap);
+    }
+
+    int64_t now = utils_now();
+    if (journal->n_pending == 0)
+        journal->pending_since = now;
+
+    memcpy(journal->pending + journal->n_pending, head, n_head);
+    if (has_chars && edit->n_chars)
+        memcpy(journal->pending + journal->n_pending + n_head, edit->chars, edit->n_chars);
+    journal->n_pending += n_record;
+
+    if (journal->n_pending >= JOURNAL_COMMIT_BYTES || now - journal->pending_since >= JOURNAL_COMMIT_NS)
+        journal_flush(journal);
+}
+
+void journal_flush(struct journal *journal) {
+    if (journal->n_pending == 0)
+        return;
+
+    if (journal_write_all(journal->fd, journal->pending, journal->n_pending))
+        fsync(journal->fd);
+
+    journal->n_pending = 0;
+}
+
+// For when the edits are saved or given up on
+void journal_discard(struct journal *journal) {
+    close(journal->fd);
+    unlink(journal->path);
+
+    free(journal->path);
+    free(journal->pending);
+    free(journal);
+}
+
+bool journal_found(const char *filename) {
+    char *path = journal_path(filename);
+    bool found = access(path, F_OK) == 0;
+    free(path);
+
+    return found;
+}
+
+// Returns -1 if the record doesn't fit the buffer as replayed so far, as when
+// it was cut short, and -2 if it does but the buffer is out of memory for it
+static ERRCODE journal_apply(struct buffer *buffer, int type, uint64_t row, uint64_t at, const char *chars,
+                             uint64_t n_chars) {
+    if (type == EDIT_INSERT_ROW) {
+        if (row > (uint64_t) buffer->n_rows)
+            return -1;
+
+        struct erow *erow = erow_create(chars, n_chars, buffer);
+        if (buffer_insert_row(buffer, erow, row))
+            return 0;
+
+        erow_free(erow);
+        return -2;
+    }
+
+    if (row >= (uint64_t) buffer->n_rows)
+        return -1;
+
+    if (type == EDIT_DELETE_ROW)
+        return buffer_delete_row(buffer, row) ? 0 : -2;
+
+    if (type != EDIT_INSERT_CHARS && type != EDIT_DELETE_CHARS)
+        return -1;
+
+    struct erow *erow = buffer_get_row(buffer, row);
+    if (at > erow->n_chars || (type == EDIT_DELETE_CHARS && n_chars > erow->n_chars - at))
+        return -1;
+
+    if ((erow = buffer_edit_row(buffer, row)) == NULL)
+        return -2;
+
+    if (type == EDIT_INSERT_CHARS) erow_insert_chars(erow, chars, n_chars, at);
+    else erow_delete_chars(erow, n_chars, at);
+
+    return 0;
+}
+
+// Replays a journal left behind onto the freshly loaded buffer, which must be
+// fully loaded, and keeps appending to it from there. A record cut short by
+// a crash ends the replay and is cut off. Running out of memory ends it too,
+// returning -5, but then the journal is left as it is and not appended to.
+ERRCODE journal_recover(struct buffer *buffer, int *n_edits) {
+    ERRCODE errcode = 0;
+
+    char *path = journal_path(buffer->filename);
+    char *chars = NULL;
+    *n_edits = 0;
+
+    int fd = open(path, O_RDWR);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1)
+        RETURN(-1);
+
+    size_t n_chars = st.st_size;
+    chars = malloc(MAX(n_chars, 1));
+
+    for (size_t n_read = 0; n_read < n_chars;) {
+        ssize_t n = read(fd, chars + n_read, n_chars - n_read);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            RETURN(-2);
+
+        n_read += n;
+    }
+
+    struct journal_header expected;
+    journal_fill_header(&expected, &buffer->file_stat);
+    if (n_chars < sizeof(expected) || memcmp(chars, &expected, sizeof(expected)) != 0)
+        RETURN(-3);
+
+    const char *c = chars + sizeof(expected), *end = chars + n_chars;
+    buffer->untracked = true;
+
+    ERRCODE applied = 0;
+    while (c < end) {
+        const char *record = c;
+
+        int type = *c++;
+        uint64_t row, at, n;
+        bool valid = journal_get_varint(&c, end, &row) && journal_get_varint(&c, end, &at)
+            && journal_get_varint(&c, end, &n);
+
+        bool has_chars = type == EDIT_INSERT_CHARS || type == EDIT_INSERT_ROW;
+        if (valid && has_chars && n > (uint64_t) (end - c))
+            valid = false;
+
+        if (!valid || (applied = journal_apply(buffer, type, row, at, c, n))) {
+            c = record;
+            break;
+        }
+
+        if (has_chars)
+            c += n;
+        (*n_edits)++;
+    }
+
+    buffer->untracked = false;
+    if (*n_edits) {
+        // Nothing in the history leads back to what is on disk now
+        undo_clear(buffer->undo);
+        buffer->modified = true;
+        buffer->hl_from = 0;
+    }
+
+    // The edits left over are still good, only memory ran out for them
+    if (applied == -2) {
+        buffer->journal_failed = true;
+        RETURN(-5);
+    }
+
+    if (c < end) {
+        size_t n_valid = c - chars;
+        if (ftruncate(fd, n_valid) == -1)
+            RETURN(-4);
+    }
+
+    lseek(fd, 0, SEEK_END);
+    buffer->journal = journal_create(path, fd);
+
+END:
+    if (errcode) {
+        if (fd != -1)
+            close(fd);
+        free(path);
+    }
+
+    free(chars);
+
+    return errcode;
+}
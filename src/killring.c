@@ -0,0 +1,84 @@
+#include <stdlib.h>
+
+#include "buffer.h"
+#include "erow.h"
+#include "intern.h"
+#include "killring.h"
+
+static void killring_drop(struct kill *kill);
+
+struct killring *killring_create(void) {
+    struct killring *ring = malloc(sizeof(struct killring));
+
+    ring->newest = ring->n_kills = 0;
+
+    return ring;
+}
+
+// Takes rows, none of which may still be in a buffer, and the array itself
+void killring_push(struct killring *ring, struct erow **rows, int n_rows) {
+    ring->newest = (ring->newest + 1) % KILLRING_SIZE;
+
+    if (ring->n_kills == KILLRING_SIZE) killring_drop(&ring->kills[ring->newest]);
+    else ring->n_kills++;
+
+    ring->kills[ring->newest] = (struct kill) { rows, n_rows };
+}
+
+// A row for buffer showing what erow does. Text from the same buffer is
+// shared, anything else copied.
+struct erow *killring_clone(struct erow *erow, struct buffer *buffer) {
+    if (erow->buffer != buffer)
+        return erow_create(erow->chars, erow->n_chars, buffer);
+
+    struct intern_line *line = intern_share(buffer->intern, erow, buffer->slab);
+    return erow_create_shared(buffer->slab, line, buffer);
+}
+
+// New rows for buffer, showing the kill age steps older than the newest, or
+// NULL if there are not that many
+struct erow **killring_paste(struct killring *ring, int age, struct buffer *buffer, int *n_rows) {
+    if (age >= ring->n_kills)
+        return NULL;
+
+    struct kill *kill = &ring->kills[(ring->newest - age + KILLRING_SIZE) % KILLRING_SIZE];
+    struct erow **rows = malloc(sizeof(struct erow *) * (kill->n_rows ? kill->n_rows : 1));
+
+    for (int i = 0; i < kill->n_rows; i++)
+        rows[i] = killring_clone(kill->rows[i], buffer);
+
+    *n_rows = kill->n_rows;
+    return rows;
+}
+
+// Called before buffer drops its rows, and with them its slab, to copy out
+// the text of every row taken from it
+void killring_release(struct killring *ring, struct buffer *buffer) {
+    for (int i = 0; i < ring->n_kills; i++) {
+        struct kill *kill = &ring->kills[(ring->newest - i + KILLRING_SIZE) % KILLRING_SIZE];
+
+        for (int j = 0; j < kill->n_rows; j++) {
+            struct erow *erow = kill->rows[j];
+
+            // The old row goes with the slab
+            if (erow->buffer == buffer)
+                kill->rows[j] = erow_create(erow->chars, erow->n_chars, NULL);
+        }
+    }
+}
+
+void killring_free(struct killring *ring) {
+    for (int i = 0; i < ring->n_kills; i++)
+        killring_drop(&ring->kills[(ring->newest - i + KILLRING_SIZE) % KILLRING_SIZE]);
+
+    free(ring);
+}
+
+/*****************************************************************************/
+
+static void killring_drop(struct kill *kill) {
+    for (int i = 0; i < kill->n_rows; i++)
+        erow_free(kill->rows[i]);
+
+    free(kill->rows);
+}
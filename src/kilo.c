@@ -3,41 +3,113 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "buffer.h"
+#include "cursor.h"
 #include "input.h"
+#include "journal.h"
 #include "kilo.h"
+#include "killring.h"
+#include "macro.h"
 #include "terminal.h"
 #include "ui.h"
+#include "undo.h"
 #include "utils.h"
 
-void editor_init(char *filename);
+void editor_init(char **filenames, int n_filenames);
+static void editor_recover(void);
+static void editor_prefetch(void);
+static void editor_reclaim(void);
 void editor_resize();
 
 struct editor_state E;
 
+static void usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [-f] [-p] [-i] [-d] [-m MiB] [-u MiB] [-z ROWS] [file...]\n"
+                    "  -f      follow the file as it grows, like tail -f\n"
+                    "  -p      page the file in on demand, whatever its size\n"
+                    "  -i      cache the line index of paged files for faster reopening\n"
+                    "  -d      store the text of identical lines once\n"
+                    "  -m MiB  memory limit, files over half of it are paged (default %zu)\n"
+                    "  -u MiB  memory limit for undo history (default %zu)\n"
+                    "  -z ROWS keep rows more than ROWS off screen compressed\n",
+            argv0, KILO_DEFAULT_MEM_LIMIT >> 20, KILO_DEFAULT_UNDO_LIMIT >> 20);
+    exit(1);
+}
+
 int main(int argc, char **argv) {
-    editor_init(argc >= 2 ? argv[1] : NULL);
+    E.mem_limit = KILO_DEFAULT_MEM_LIMIT;
+    E.undo_limit = KILO_DEFAULT_UNDO_LIMIT;
+    E.force_paged = E.index_cache = E.follow = E.intern = false;
+    E.cold_rows = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "fpidm:u:z:")) != -1) {
+        switch (opt) {
+            case 'f':
+                E.follow = true;
+                break;
+            case 'p':
+                E.force_paged = true;
+                break;
+            case 'i':
+                E.index_cache = true;
+                break;
+            case 'd':
+                E.intern = true;
+                break;
+            case 'm':
+            case 'u':
+            case 'z': {
+                char *end;
+                long value = strtol(optarg, &end, 10);
+                if (*end != '\0' || value <= 0)
+                    usage(argv[0]);
+
+                if (opt == 'm') E.mem_limit = (size_t) value << 20;
+                else if (opt == 'u') E.undo_limit = (size_t) value << 20;
+                else E.cold_rows = MIN(value, INT_MAX);
+                break;
+            }
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    editor_init(argv + optind, argc - optind);
 
     while (true) {
         ui_draw_screen();
-        input_process_key(terminal_read_key());
+
+        // Each key is its own undo step, unless it just continues typing
+        KEY key = terminal_read_key();
+        if (key != NOP)
+            undo_seal(E.current_buf->undo, E.current_buf->cx, E.current_buf->cy);
+
+        input_process_key(key);
     }
 
     return 0;
 }
 
-void editor_init(char *filename) {
-    if (!isatty(STDIN_FILENO)) {
-        printf("kilo only supports a terminal at standard in. Exiting.");
+void editor_init(char **filenames, int n_filenames) {
+    // With data piped in, the terminal is reached through /dev/tty instead
+    bool piped = !isatty(STDIN_FILENO);
+    E.tty_fd = piped ? open("/dev/tty", O_RDWR) : STDIN_FILENO;
+
+    if (E.tty_fd == -1 || !isatty(E.tty_fd)) {
+        printf("kilo needs a terminal to run in. Exiting.\n");
         exit(1);
     }
 
@@ -47,17 +119,202 @@ void editor_init(char *filename) {
         die("term_get_win_size");
     E.quit_times = 3;
 
-    E.current_buf = buffer_create();
-    if (filename)
-        buffer_read_file(E.current_buf, filename);
+    // Only the first file is read in right away
+    E.n_buffers = MAX(n_filenames, 1);
+    E.buffers = malloc(sizeof(struct editor_buffer) * E.n_buffers);
+    E.n_switches = 0;
+
+    for (int i = 0; i < E.n_buffers; i++) {
+        struct buffer *buffer = buffer_create();
+        buffer->follow = E.follow;
+
+        if (i < n_filenames) {
+            buffer->filename = malloc(strlen(filenames[i]) + 1);
+            strcpy(buffer->filename, filenames[i]);
+        }
 
-    editor_set_message("Welcome to kilo! | CTRL-Q: Quit | CTRL-S: SAVE");
+        E.buffers[i] = (struct editor_buffer) { buffer, false, false, 0, 0 };
+    }
+
+    if (n_filenames == 0 && piped) {
+        buffer_read_fd(E.buffers[0].buffer, STDIN_FILENO);
+        E.buffers[0].loaded = E.buffers[0].fetched = true;
+    }
+
+    E.macro = macro_create();
+    E.kill_ring = killring_create();
+
+    editor_switch_buffer(0);
+
+    editor_set_message("Welcome to kilo! | CTRL-Q: Quit | CTRL-S: SAVE | CTRL-T: Follow | CTRL-R: Reload");
     terminal_clear();
     error_message = NULL;
 
     struct sigaction sa;
     sa.sa_handler = editor_resize;
     sigaction(SIGWINCH, &sa, NULL);
+
+    if (E.current_buf->filename && journal_found(E.current_buf->filename))
+        editor_recover();
+}
+
+// Makes the buffer at at the current one, reading its file in if need be.
+// Everything else about it, down to its highlighting, is as it was left.
+void editor_switch_buffer(int at) {
+    struct editor_buffer *entry = &E.buffers[at];
+    bool first = entry->last_used == 0;
+
+    if (E.current_buf && E.current_buf->journal)
+        journal_flush(E.current_buf->journal);
+
+    E.buffer_at = at;
+    E.current_buf = entry->buffer;
+    entry->last_used = ++E.n_switches;
+
+    if (!entry->loaded && entry->buffer->filename) {
+        buffer_read_file(entry->buffer, entry->buffer->filename);
+        entry->loaded = entry->fetched = true;
+    }
+
+    editor_reclaim();
+
+    // Only checked here for files other than the first, see editor_init
+    if (first && at > 0 && journal_found(E.current_buf->filename))
+        editor_recover();
+}
+
+// Offers to replay the edits a previous session left unsaved
+static void editor_recover(void) {
+    struct buffer *buffer = E.current_buf;
+
+    char *answer = editor_prompt("Found unsaved edits to this file, recover them? (y/n): %s", false);
+    bool recover = answer && (answer[0] == 'y' || answer[0] == 'Y');
+    free(answer);
+
+    if (!recover) {
+        editor_set_message("Ignoring the unsaved edits, the next edit overwrites them");
+        return;
+    }
+
+    buffer_poll_load(buffer, true);
+
+    int n_edits;
+    ERRCODE errcode = journal_recover(buffer, &n_edits);
+
+    if (errcode == -3) editor_set_message("The file changed since those edits, they can't be recovered");
+    else if (errcode == -5) editor_set_message("Recovered %d edit(s), out of memory for the rest, kept in the swap file",
+                                               n_edits);
+    else if (errcode) editor_set_message("Recovery error %d: %s", errcode, strerror(errno));
+    else editor_set_message("Recovered %d edit(s), save to keep them", n_edits);
+}
+
+// Called whenever reading a key times out. Returns true if the screen needs
+// to be redrawn before waiting for input again.
+bool editor_tick(void) {
+    struct buffer *buffer = E.current_buf;
+
+    bool changed = false;
+
+    if (buffer_poll_file(buffer) == FILE_CHANGED) {
+        // Unsaved edits are never thrown away behind the user's back
+        int n_changed, n_hunks;
+        if (buffer->modified) {
+            buffer->disk_changed = true;
+            editor_set_message("%s changed on disk! CTRL-R reloads it, dropping your changes", buffer->filename);
+            changed = true;
+        } else if (buffer_reload_file(buffer, &n_changed, &n_hunks) == 0) {
+            cursor_move(buffer, 0, 0);
+            editor_set_message("%s changed on disk, %d line(s) reloaded", buffer->filename, n_changed);
+            changed = true;
+        }
+    }
+
+    // Following a file keeps the cursor at its end if that's where it was
+    bool pinned = buffer->follow && buffer->cy >= buffer->n_rows - 1;
+    bool redraw = buffer_poll_load(buffer, false);
+
+    if (redraw && pinned)
+        cursor_move(buffer, 0, buffer->n_rows - buffer->cy);
+
+    // Whatever the journal held back is written out when idle
+    if (buffer->journal)
+        journal_flush(buffer->journal);
+
+    // Files read in ahead of being switched to are taken in the same way
+    for (int i = 0; i < E.n_buffers; i++) {
+        struct buffer *other = E.buffers[i].buffer;
+
+        if (other != buffer && buffer_is_loading(other)) {
+            buffer_poll_load(other, false);
+            if (!buffer_is_loading(other))
+                editor_reclaim();
+        }
+    }
+
+    editor_prefetch();
+
+    return changed || redraw || buffer_is_loading(buffer);
+}
+
+// Starts reading the next file not yet switched to once nothing else is
+// loading, as long as it fits in half the memory limit along with the rest.
+// A file read in before is taken to need what its rows took then.
+static void editor_prefetch(void) {
+    size_t mem = 0;
+
+    for (int i = 0; i < E.n_buffers; i++) {
+        if (buffer_is_loading(E.buffers[i].buffer))
+            return;
+        mem += buffer_mem_used(E.buffers[i].buffer);
+    }
+
+    if (mem > E.mem_limit / 2)
+        return;
+
+    for (int i = 0; i < E.n_buffers; i++) {
+        struct editor_buffer *entry = &E.buffers[i];
+        struct stat st;
+
+        if (entry->fetched || entry->buffer->filename == NULL || stat(entry->buffer->filename, &st) == -1)
+            continue;
+
+        size_t needed = MAX((size_t) st.st_size, entry->mem_dropped);
+        if (mem + needed <= E.mem_limit / 2) {
+            buffer_read_file(entry->buffer, entry->buffer->filename);
+            entry->loaded = entry->fetched = true;
+            return;
+        }
+    }
+}
+
+// While buffers take more than the memory limit, drops the rows of the one
+// least recently switched to among those that can be read in again as is.
+// One only read in ahead may be read in ahead again, when there is room.
+static void editor_reclaim(void) {
+    while (true) {
+        size_t mem = 0;
+        struct editor_buffer *victim = NULL;
+
+        for (int i = 0; i < E.n_buffers; i++) {
+            struct editor_buffer *entry = &E.buffers[i];
+            struct buffer *buffer = entry->buffer;
+            mem += buffer_mem_used(buffer);
+
+            bool idle = entry->loaded && buffer != E.current_buf && buffer->filename && !buffer->modified;
+            if (idle && (victim == NULL || entry->last_used < victim->last_used))
+                victim = entry;
+        }
+
+        if (mem <= E.mem_limit || victim == NULL)
+            return;
+
+        victim->mem_dropped = buffer_mem_used(victim->buffer);
+        buffer_unload(victim->buffer);
+        victim->loaded = false;
+
+        if (victim->last_used == 0)
+            victim->fetched = false;
+    }
 }
 
 void editor_set_message(const char *fmt, ...) {
@@ -69,8 +326,9 @@ void editor_set_message(const char *fmt, ...) {
   E.message_time = time(NULL);
 }
 
+// Returns NULL on ESC, or on ENTER with nothing typed unless allow_empty is set
 // TODO: This could use some work
-char *editor_prompt(const char *prompt) {
+char *editor_prompt(const char *prompt, bool allow_empty) {
     size_t buf_cap = 64;
     size_t buf_size = 0;
     char *buf = malloc(buf_cap);
@@ -94,7 +352,7 @@ char *editor_prompt(const char *prompt) {
                     buf[--buf_size] = '\0';
                 break;
             case ENTER:
-                if (buf_size > 0) goto success;
+                if (buf_size > 0 || allow_empty) goto success;
                 else goto failure;
                 break;
             case ESCAPE:
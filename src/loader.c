@@ -0,0 +1,445 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "cold.h"
+#include "erow.h"
+#include "intern.h"
+#include "loader.h"
+#include "pager.h"
+#include "slab.h"
+#include "utils.h"
+#include "words.h"
+
+#define LOADER_READ_SIZE (1 << 20)
+#define LOADER_FIRST_BATCH 256
+#define LOADER_MAX_BATCH (1 << 16)
+
+// Pipes are waited on this long at a time, and what has come in so far is
+// published at least this often
+#define LOADER_STREAM_POLL_MS 100
+#define LOADER_STREAM_PUBLISH_NS (100 * 1000000LL)
+
+// Returned by loader_read when a pipe stayed quiet through a poll
+#define LOADER_READ_IDLE -2
+
+struct loader {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    int fd;
+    off_t offset;
+    struct buffer *buffer;
+    bool streaming;
+
+    // Set if rows go into compressed blocks, this one being filled
+    bool cold;
+    struct cold_block *block;
+
+    // Non-NULL if identical rows share their text, holding the current batch's
+    struct intern *intern;
+
+    // Set if the buffer counts words
+    bool words;
+
+    // Everything below is guarded by lock
+    struct load_batch *head, *tail;
+    size_t bytes_read, bytes_total;
+    bool done, cancelled, tail_partial;
+};
+
+static void *loader_run(void *arg);
+static void *loader_run_index(void *arg);
+
+// Reads fd from offset to its end. Bytes before offset are assumed to be
+// loaded already.
+struct loader *loader_start(int fd, off_t offset, struct buffer *buffer, bool index_only) {
+    struct loader *loader = malloc(sizeof(struct loader));
+
+    pthread_mutex_init(&loader->lock, NULL);
+    pthread_cond_init(&loader->cond, NULL);
+
+    loader->fd = fd;
+    loader->offset = offset;
+    loader->buffer = buffer;
+
+    loader->cold = buffer->cold != NULL;
+    loader->block = NULL;
+    loader->intern = buffer->intern ? intern_create() : NULL;
+    loader->words = buffer->words != NULL;
+
+    loader->head = loader->tail = NULL;
+    loader->bytes_read = 0;
+    loader->done = loader->cancelled = loader->tail_partial = false;
+
+    struct stat st;
+    bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    loader->bytes_total = (regular && st.st_size > offset ? (size_t) (st.st_size - offset) : 0);
+    loader->streaming = !regular;
+
+    if (offset)
+        lseek(fd, offset, SEEK_SET);
+
+    if (pthread_create(&loader->thread, NULL, index_only ? loader_run_index : loader_run, loader) != 0)
+        die("pthread_create");
+
+    return loader;
+}
+
+// Detaches every batch published so far. If wait is set, blocks until the
+// loader has finished so the returned list is the rest of the file.
+struct load_batch *loader_take(struct loader *loader, bool wait, bool *done) {
+    pthread_mutex_lock(&loader->lock);
+
+    while (wait && !loader->done)
+        pthread_cond_wait(&loader->cond, &loader->lock);
+
+    struct load_batch *batches = loader->head;
+    loader->head = loader->tail = NULL;
+    *done = loader->done;
+
+    pthread_mutex_unlock(&loader->lock);
+
+    return batches;
+}
+
+void loader_progress(struct loader *loader, size_t *bytes_read, size_t *bytes_total) {
+    pthread_mutex_lock(&loader->lock);
+
+    *bytes_read = loader->bytes_read;
+    *bytes_total = loader->bytes_total;
+
+    pthread_mutex_unlock(&loader->lock);
+}
+
+// Whether the last line read had no newline, only meaningful once done
+bool loader_tail_partial(struct loader *loader) {
+    pthread_mutex_lock(&loader->lock);
+    bool tail_partial = loader->tail_partial;
+    pthread_mutex_unlock(&loader->lock);
+
+    return tail_partial;
+}
+
+void load_batch_free(struct load_batch *batch) {
+    for (int i = 0; i < batch->n_blocks; i++)
+        cold_block_free(batch->blocks[i]);
+
+    free(batch->rows);
+    free(batch->blocks);
+    free(batch->extents);
+
+    if (batch->words)
+        words_free(batch->words);
+
+    if (batch->slab)
+        slab_free(batch->slab);
+
+    free(batch);
+}
+
+void loader_free(struct loader *loader) {
+    pthread_mutex_lock(&loader->lock);
+    loader->cancelled = true;
+    pthread_mutex_unlock(&loader->lock);
+
+    pthread_join(loader->thread, NULL);
+
+    while (loader->head) {
+        struct load_batch *next = loader->head->next;
+        load_batch_free(loader->head);
+        loader->head = next;
+    }
+
+    if (loader->intern)
+        intern_free(loader->intern);
+
+    pthread_cond_destroy(&loader->cond);
+    pthread_mutex_destroy(&loader->lock);
+    free(loader);
+}
+
+/*****************************************************************************/
+
+static struct load_batch *loader_batch_create(int capacity) {
+    struct load_batch *batch = malloc(sizeof(struct load_batch));
+
+    batch->rows = malloc(sizeof(struct erow *) * capacity);
+    batch->n_rows = 0;
+
+    batch->blocks = NULL;
+    batch->n_blocks = 0;
+    batch->words = NULL;
+
+    batch->extents = NULL;
+    batch->n_extents = 0;
+
+    batch->slab = slab_create();
+    batch->next = NULL;
+
+    return batch;
+}
+
+static bool loader_cancelled(struct loader *loader) {
+    pthread_mutex_lock(&loader->lock);
+    bool cancelled = loader->cancelled;
+    pthread_mutex_unlock(&loader->lock);
+
+    return cancelled;
+}
+
+// Reads the next block. Pipes are polled so that cancelling is noticed even
+// while nothing is being written to them, and with rows pending, so that they
+// are published rather than held back until more comes in.
+static ssize_t loader_read(struct loader *loader, char *block, bool pending) {
+    while (loader->streaming) {
+        struct pollfd pollfd = { loader->fd, POLLIN, 0 };
+        int n_ready = poll(&pollfd, 1, LOADER_STREAM_POLL_MS);
+
+        if (loader_cancelled(loader))
+            return 0;
+        if (n_ready == 1 || (n_ready == -1 && errno != EINTR))
+            break;
+        if (n_ready == 0 && pending)
+            return LOADER_READ_IDLE;
+    }
+
+    return read(loader->fd, block, LOADER_READ_SIZE);
+}
+
+static void loader_finish(struct loader *loader, bool tail_partial) {
+    close(loader->fd);
+
+    pthread_mutex_lock(&loader->lock);
+    loader->tail_partial = tail_partial;
+    loader->done = true;
+    pthread_cond_broadcast(&loader->cond);
+    pthread_mutex_unlock(&loader->lock);
+}
+
+// Seals the block being filled and hands it to the batch
+static void loader_end_block(struct loader *loader, struct load_batch *batch) {
+    if (loader->block == NULL)
+        return;
+
+    cold_block_seal(loader->block);
+
+    batch->blocks = realloc(batch->blocks, sizeof(struct cold_block *) * (batch->n_blocks + 1));
+    batch->blocks[batch->n_blocks++] = loader->block;
+    loader->block = NULL;
+}
+
+static void loader_add_row(struct loader *loader, struct load_batch *batch, const char *chars, size_t n_chars) {
+    if (loader->words) {
+        if (batch->words == NULL)
+            batch->words = words_create();
+        words_count(batch->words, chars, n_chars, 1);
+    }
+
+    if (loader->intern) {
+        struct intern_line *line = intern_get(loader->intern, batch->slab, chars, n_chars);
+        batch->rows[batch->n_rows++] = erow_create_shared(batch->slab, line, loader->buffer);
+        return;
+    }
+
+    if (!loader->cold) {
+        batch->rows[batch->n_rows++] = erow_create_in(batch->slab, chars, n_chars, loader->buffer);
+        return;
+    }
+
+    if (loader->block == NULL)
+        loader->block = cold_block_create();
+
+    batch->rows[batch->n_rows++] = cold_block_add(loader->block, batch->slab, chars, n_chars, loader->buffer);
+
+    if (cold_block_full(loader->block))
+        loader_end_block(loader, batch);
+}
+
+static void loader_publish(struct loader *loader, struct load_batch *batch) {
+    loader_end_block(loader, batch);
+
+    // The batch's lines are shared across batches once the buffer takes them
+    if (loader->intern)
+        intern_clear(loader->intern);
+
+    pthread_mutex_lock(&loader->lock);
+
+    if (loader->tail) loader->tail->next = batch;
+    else loader->head = batch;
+    loader->tail = batch;
+
+    pthread_mutex_unlock(&loader->lock);
+}
+
+static void *loader_run(void *arg) {
+    struct loader *loader = arg;
+
+    char *block = malloc(LOADER_READ_SIZE);
+
+    // A line that straddles two reads is gathered here
+    size_t line_cap = 256, line_len = 0;
+    char *line = malloc(line_cap);
+
+    int batch_cap = LOADER_FIRST_BATCH;
+    struct load_batch *batch = loader_batch_create(batch_cap);
+    bool published = false;
+    int64_t published_at = 0;
+
+    while (!loader_cancelled(loader)) {
+        ssize_t n_read = loader_read(loader, block, batch->n_rows > 0);
+        if (n_read == -1 && errno == EINTR)
+            continue;
+
+        if (n_read == LOADER_READ_IDLE) {
+            loader_publish(loader, batch);
+            published = true;
+            published_at = utils_now();
+
+            batch = loader_batch_create(batch_cap);
+            continue;
+        }
+
+        if (n_read <= 0)
+            break;
+
+        for (char *c = block, *end = block + n_read; c < end;) {
+            char *newline = memchr(c, '\n', end - c);
+            char *line_end = newline ? newline : end;
+
+            if (line_len || newline == NULL) {
+                size_t n_chars = line_end - c;
+                while (line_len + n_chars > line_cap)
+                    line = realloc(line, line_cap *= 2);
+
+                memcpy(line + line_len, c, n_chars);
+                line_len += n_chars;
+            }
+
+            if (newline == NULL)
+                break;
+
+            bool carried = line_len > 0;
+            loader_add_row(loader, batch, carried ? line : c, carried ? line_len : (size_t) (newline - c));
+            line_len = 0;
+            c = newline + 1;
+
+            if (batch->n_rows == batch_cap) {
+                loader_publish(loader, batch);
+                published = true;
+                published_at = utils_now();
+
+                batch_cap = MIN(batch_cap * 4, LOADER_MAX_BATCH);
+                batch = loader_batch_create(batch_cap);
+            }
+        }
+
+        pthread_mutex_lock(&loader->lock);
+        loader->bytes_read += n_read;
+        pthread_mutex_unlock(&loader->lock);
+
+        // Get something on screen even if the first lines are very long, and
+        // keep it coming for pipes that write slowly
+        bool due = loader->streaming && utils_now() - published_at >= LOADER_STREAM_PUBLISH_NS;
+        if ((!published || due) && batch->n_rows) {
+            loader_publish(loader, batch);
+            published = true;
+            published_at = utils_now();
+
+            batch = loader_batch_create(batch_cap);
+        }
+    }
+
+    bool tail_partial = line_len > 0;
+    if (tail_partial)
+        loader_add_row(loader, batch, line, line_len);
+
+    if (batch->n_rows) loader_publish(loader, batch);
+    else load_batch_free(batch);
+
+    free(line);
+    free(block);
+
+    loader_finish(loader, tail_partial);
+    return NULL;
+}
+
+// Only cuts the file into page extents at line boundaries, one batch per read
+static void *loader_run_index(void *arg) {
+    struct loader *loader = arg;
+
+    char *block = malloc(LOADER_READ_SIZE);
+    struct page_extent extent = { loader->offset, 0, 0 };
+    size_t n_partial = 0;
+
+    while (!loader_cancelled(loader)) {
+        ssize_t n_read = loader_read(loader, block, false);
+        if (n_read == -1 && errno == EINTR)
+            continue;
+        if (n_read <= 0)
+            break;
+
+        struct load_batch *batch = calloc(1, sizeof(struct load_batch));
+        int extents_cap = 0;
+
+        for (char *c = block, *end = block + n_read; c < end;) {
+            char *newline = memchr(c, '\n', end - c);
+            if (newline == NULL) {
+                extent.n_bytes += end - c;
+                n_partial += end - c;
+                break;
+            }
+
+            extent.n_bytes += newline + 1 - c;
+            extent.n_rows++;
+            n_partial = 0;
+            c = newline + 1;
+
+            if (extent.n_rows == PAGER_PAGE_ROWS || extent.n_bytes >= PAGER_PAGE_BYTES) {
+                if (batch->n_extents == extents_cap) {
+                    extents_cap = MAX(extents_cap * 2, 16);
+                    batch->extents = realloc(batch->extents, sizeof(struct page_extent) * extents_cap);
+                }
+
+                batch->extents[batch->n_extents++] = extent;
+
+                extent.offset += extent.n_bytes;
+                extent.n_bytes = 0;
+                extent.n_rows = 0;
+            }
+        }
+
+        pthread_mutex_lock(&loader->lock);
+        loader->bytes_read += n_read;
+        pthread_mutex_unlock(&loader->lock);
+
+        if (batch->n_extents) loader_publish(loader, batch);
+        else load_batch_free(batch);
+    }
+
+    // A last line without a newline is still a row
+    if (extent.n_bytes) {
+        struct load_batch *batch = calloc(1, sizeof(struct load_batch));
+
+        if (n_partial)
+            extent.n_rows++;
+        batch->extents = malloc(sizeof(struct page_extent));
+        batch->extents[batch->n_extents++] = extent;
+
+        loader_publish(loader, batch);
+    }
+
+    free(block);
+
+    loader_finish(loader, n_partial > 0);
+    return NULL;
+}
@@ -0,0 +1,138 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+#include "utils.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+static void lz_put_length(unsigned char **op, size_t len);
+static void lz_put_sequence(unsigned char **op, const unsigned char *literals, size_t n_literals,
+                            size_t offset, size_t match_len);
+static ERRCODE lz_get_length(const unsigned char **ip, const unsigned char *end, size_t *len);
+
+// dst must have room for LZ_BOUND(n_src) bytes. Returns how many it took.
+size_t lz_compress(const char *src, size_t n_src, char *dst) {
+    const unsigned char *in = (const unsigned char *) src;
+    const unsigned char *ip = in, *anchor = in, *end = in + n_src;
+    unsigned char *op = (unsigned char *) dst;
+
+    // Last position each hashed 4 bytes were seen at
+    uint32_t table[1 << LZ_HASH_BITS] = { 0 };
+
+    while (end - ip >= LZ_MIN_MATCH) {
+        uint32_t seq, ref_seq;
+        memcpy(&seq, ip, sizeof(seq));
+
+        uint32_t hash = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        const unsigned char *ref = in + table[hash];
+        table[hash] = ip - in;
+
+        memcpy(&ref_seq, ref, sizeof(ref_seq));
+        if (ref >= ip || ip - ref > LZ_MAX_OFFSET || ref_seq != seq) {
+            ip++;
+            continue;
+        }
+
+        const unsigned char *match_end = ip + LZ_MIN_MATCH;
+        while (match_end < end && *match_end == ref[match_end - ip])
+            match_end++;
+
+        lz_put_sequence(&op, anchor, ip - anchor, ip - ref, match_end - ip);
+        ip = anchor = match_end;
+    }
+
+    lz_put_sequence(&op, anchor, end - anchor, 0, 0);
+
+    return op - (unsigned char *) dst;
+}
+
+// Fails unless src decodes to exactly n_dst bytes
+ERRCODE lz_decompress(const char *src, size_t n_src, char *dst, size_t n_dst) {
+    const unsigned char *ip = (const unsigned char *) src, *end = ip + n_src;
+    unsigned char *out = (unsigned char *) dst, *op = out, *out_end = out + n_dst;
+
+    while (ip < end) {
+        unsigned token = *ip++;
+
+        size_t n_literals = token >> 4;
+        if (n_literals == 15 && lz_get_length(&ip, end, &n_literals) == -1)
+            return -1;
+        if (n_literals > (size_t) (end - ip) || n_literals > (size_t) (out_end - op))
+            return -1;
+
+        memcpy(op, ip, n_literals);
+        ip += n_literals;
+        op += n_literals;
+
+        if (ip == end)
+            break;
+        if (end - ip < 2)
+            return -1;
+
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        size_t match_len = token & 15;
+        if (match_len == 15 && lz_get_length(&ip, end, &match_len) == -1)
+            return -1;
+        match_len += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > (size_t) (op - out) || match_len > (size_t) (out_end - op))
+            return -1;
+
+        // Matches may overlap what they copy, so go a byte at a time
+        for (const unsigned char *ref = op - offset; match_len--;)
+            *op++ = *ref++;
+    }
+
+    return op == out_end ? 0 : -1;
+}
+
+/*****************************************************************************/
+
+// Lengths that don't fit their 4 bits go on in bytes of 255, ending with
+// one below that
+static void lz_put_length(unsigned char **op, size_t len) {
+    for (; len >= 255; len -= 255)
+        *(*op)++ = 255;
+
+    *(*op)++ = len;
+}
+
+static void lz_put_sequence(unsigned char **op, const unsigned char *literals, size_t n_literals,
+                            size_t offset, size_t match_len) {
+    size_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+
+    *(*op)++ = (MIN(n_literals, 15) << 4) | MIN(match_code, 15);
+    if (n_literals >= 15)
+        lz_put_length(op, n_literals - 15);
+
+    memcpy(*op, literals, n_literals);
+    *op += n_literals;
+
+    if (match_len == 0)
+        return;
+
+    *(*op)++ = offset & 0xff;
+    *(*op)++ = offset >> 8;
+
+    if (match_code >= 15)
+        lz_put_length(op, match_code - 15);
+}
+
+static ERRCODE lz_get_length(const unsigned char **ip, const unsigned char *end, size_t *len) {
+    unsigned byte;
+
+    do {
+        if (*ip == end)
+            return -1;
+
+        byte = *(*ip)++;
+        *len += byte;
+    } while (byte == 255);
+
+    return 0;
+}
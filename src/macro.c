@@ -0,0 +1,71 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "buffer.h"
+#include "input.h"
+#include "kilo.h"
+#include "macro.h"
+#include "utils.h"
+
+struct macro *macro_create(void) {
+    struct macro *macro = malloc(sizeof(struct macro));
+
+    macro->keys = NULL;
+    macro->n_keys = macro->keys_cap = 0;
+    macro->recording = false;
+
+    return macro;
+}
+
+// Starting a new recording throws the last one away
+void macro_start(struct macro *macro) {
+    macro->n_keys = 0;
+    macro->recording = true;
+}
+
+void macro_stop(struct macro *macro) {
+    macro->recording = false;
+}
+
+void macro_record(struct macro *macro, KEY key) {
+    if (!macro->recording)
+        return;
+
+    if (macro->n_keys == macro->keys_cap) {
+        macro->keys_cap = MAX(macro->keys_cap * 2, 64);
+        macro->keys = realloc(macro->keys, sizeof(KEY) * macro->keys_cap);
+    }
+
+    macro->keys[macro->n_keys++] = key;
+}
+
+// Runs the macro n_times over, or until a key is pressed. Returns how many
+// times it ran.
+int macro_replay(struct macro *macro, struct buffer *buffer, int n_times) {
+    int64_t shown_at = utils_now();
+    int n_done = 0;
+
+    buffer_begin(buffer);
+
+    for (; n_done < n_times; n_done++) {
+        for (int i = 0; i < macro->n_keys; i++)
+            input_process_key(macro->keys[i]);
+
+        if (utils_progress(&shown_at, "Replaying macro, %d of %d done (any key cancels)", n_done + 1, n_times)) {
+            n_done++;
+            break;
+        }
+    }
+
+    buffer_commit(buffer, buffer->cx, buffer->cy);
+
+    return n_done;
+}
+
+void macro_free(struct macro *macro) {
+    free(macro->keys);
+    free(macro);
+}
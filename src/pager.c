@@ -0,0 +1,526 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "erow.h"
+#include "pager.h"
+#include "slab.h"
+#include "utils.h"
+
+#define PAGER_IO_SIZE (1 << 20)
+
+static void pager_lru_unlink(struct pager *pager, int p);
+static void pager_lru_push(struct pager *pager, int p);
+static void pager_evict(struct pager *pager, int p);
+static void pager_make_room(struct pager *pager, size_t needed);
+static void pager_load(struct pager *pager, int p);
+static void pager_adopt(struct pager *pager, int p);
+static bool pager_make_dirty(struct pager *pager, int p, size_t extra);
+static int pager_find(struct pager *pager, int at);
+static void pager_shift(struct pager *pager, int p, int by);
+
+struct pager *pager_create(int fd, struct buffer *buffer, size_t mem_limit) {
+    struct pager *pager = malloc(sizeof(struct pager));
+
+    pager->fd = fd;
+    pager->buffer = buffer;
+
+    pager->pages = NULL;
+    pager->n_pages = pager->pages_cap = 0;
+    pager->last_page = 0;
+
+    pager->lru_head = pager->lru_tail = -1;
+
+    pager->mem_pages = 0;
+    pager->mem_limit = MAX(mem_limit, PAGER_MIN_MEM_LIMIT);
+    pager->n_loads = pager->n_evictions = 0;
+
+    return pager;
+}
+
+void pager_append(struct pager *pager, const struct page_extent *extents, int n_extents) {
+    if (pager->n_pages + n_extents > pager->pages_cap) {
+        pager->pages_cap = MAX(pager->pages_cap * 2, pager->n_pages + n_extents);
+        pager->pages = realloc(pager->pages, sizeof(struct page) * pager->pages_cap);
+    }
+
+    for (int i = 0; i < n_extents; i++) {
+        struct page *page = &pager->pages[pager->n_pages];
+        struct page *prev = (pager->n_pages ? page - 1 : NULL);
+
+        page->extent = extents[i];
+        page->first_row = (prev ? prev->first_row + prev->n_rows : 0);
+        page->n_rows = extents[i].n_rows;
+
+        page->rows = NULL;
+        page->rows_cap = 0;
+        page->slab = NULL;
+        page->mem = 0;
+
+        page->dirty = false;
+        page->lru_prev = page->lru_next = -1;
+
+        pager->n_pages++;
+    }
+}
+
+int pager_n_rows(struct pager *pager) {
+    if (pager->n_pages == 0)
+        return 0;
+
+    struct page *last = &pager->pages[pager->n_pages - 1];
+    return last->first_row + last->n_rows;
+}
+
+// Drops the last page so that it can be indexed again, as long as it has no
+// edits. Used when more is appended to a file whose last line was partial.
+bool pager_pop_page(struct pager *pager, struct page_extent *extent) {
+    if (pager->n_pages == 0 || pager->pages[pager->n_pages - 1].dirty)
+        return false;
+
+    int p = pager->n_pages - 1;
+    if (pager->pages[p].rows)
+        pager_evict(pager, p);
+
+    *extent = pager->pages[p].extent;
+    pager->n_pages--;
+
+    if (pager->last_page == p)
+        pager->last_page = 0;
+
+    return true;
+}
+
+struct erow *pager_get_row(struct pager *pager, int at) {
+    int p = pager_find(pager, at);
+    if (p == -1)
+        return NULL;
+
+    struct page *page = &pager->pages[p];
+    if (page->rows == NULL) {
+        pager_load(pager, p);
+    } else if (!page->dirty && pager->lru_head != p) {
+        pager_lru_unlink(pager, p);
+        pager_lru_push(pager, p);
+    }
+
+    return page->rows[at - page->first_row];
+}
+
+// Same as pager_get_row, but the row's page is moved into the edit overlay
+// first. Returns NULL if that would take the editor over its memory limit.
+struct erow *pager_edit_row(struct pager *pager, int at) {
+    int p = pager_find(pager, at);
+    if (p == -1)
+        return NULL;
+
+    if (!pager_make_dirty(pager, p, 0))
+        return NULL;
+
+    struct page *page = &pager->pages[p];
+    return page->rows[at - page->first_row];
+}
+
+// Edited rows all live in dirty pages, so only those are searched
+int pager_find_row(struct pager *pager, const struct erow *erow) {
+    for (int p = 0; p < pager->n_pages; p++) {
+        struct page *page = &pager->pages[p];
+        if (!page->dirty)
+            continue;
+
+        for (int i = 0; i < page->n_rows; i++)
+            if (page->rows[i] == erow)
+                return page->first_row + i;
+    }
+
+    return -1;
+}
+
+// Returns false, leaving the row to the caller, if that would take the editor
+// over its memory limit
+bool pager_insert_row(struct pager *pager, struct erow *erow, int at) {
+    int p;
+    if (pager->n_pages == 0) {
+        struct page_extent extent = { 0, 0, 0 };
+        pager_append(pager, &extent, 1);
+        p = 0;
+    } else p = (at >= pager_n_rows(pager) ? pager->n_pages - 1 : pager_find(pager, at));
+
+    struct page *page = &pager->pages[p];
+    size_t grown = sizeof(struct erow *) * MAX(page->rows_cap, 16);
+    if (!pager_make_dirty(pager, p, page->n_rows == page->rows_cap ? grown : 0))
+        return false;
+
+    if (page->n_rows == page->rows_cap) {
+        pager->mem_pages -= page->mem;
+
+        page->rows_cap = MAX(page->rows_cap * 2, 16);
+        page->rows = realloc(page->rows, sizeof(struct erow *) * page->rows_cap);
+        page->mem = sizeof(struct erow *) * page->rows_cap;
+
+        pager->mem_pages += page->mem;
+    }
+
+    int i = at - page->first_row;
+    memmove(page->rows + i + 1, page->rows + i, sizeof(struct erow *) * (page->n_rows - i));
+    page->rows[i] = erow;
+    page->n_rows++;
+
+    pager_shift(pager, p, 1);
+    return true;
+}
+
+// Returns false if that would take the editor over its memory limit. Rows
+// already returned by pager_edit_row can always be deleted.
+bool pager_delete_row(struct pager *pager, int at) {
+    int p = pager_find(pager, at);
+    if (p == -1 || !pager_make_dirty(pager, p, 0))
+        return false;
+
+    struct page *page = &pager->pages[p];
+    int i = at - page->first_row;
+    erow_free(page->rows[i]);
+    memmove(page->rows + i, page->rows + i + 1, sizeof(struct erow *) * (page->n_rows - i - 1));
+    page->n_rows--;
+
+    pager_shift(pager, p, -1);
+    return true;
+}
+
+static bool pager_write_all(int fd, const char *chars, size_t n_chars) {
+    while (n_chars) {
+        ssize_t n_written = write(fd, chars, n_chars);
+        if (n_written == -1 && errno == EINTR)
+            continue;
+        if (n_written <= 0)
+            return false;
+
+        chars += n_written;
+        n_chars -= n_written;
+    }
+
+    return true;
+}
+
+// Written to a temporary next to the file and renamed over it, since clean
+// pages are copied straight out of the original
+ERRCODE pager_write(struct pager *pager, const char *filename, size_t *bytes_written) {
+    ERRCODE errcode = 0;
+
+    size_t filename_len = strlen(filename);
+    char *tmp_filename = malloc(filename_len + 12);
+    snprintf(tmp_filename, filename_len + 12, "%s.kilo-save", filename);
+
+    struct stat st;
+    mode_t mode = (fstat(pager->fd, &st) == 0 ? st.st_mode & 0777 : 0644);
+
+    struct page_extent *extents = malloc(sizeof(struct page_extent) * MAX(pager->n_pages, 1));
+    struct append_buf *out = ab_create();
+    char *io = malloc(PAGER_IO_SIZE);
+    off_t offset = 0;
+
+    int fd = open(tmp_filename, O_WRONLY | O_CREAT | O_TRUNC, mode);
+    if (fd == -1)
+        RETURN(-2);
+
+    for (int p = 0; p < pager->n_pages; p++) {
+        struct page *page = &pager->pages[p];
+        size_t n_bytes = 0;
+
+        if (page->dirty) {
+            for (int i = 0; i < page->n_rows; i++) {
+                ab_append(out, page->rows[i]->chars, page->rows[i]->n_chars);
+                ab_append(out, "\n", 1);
+                n_bytes += page->rows[i]->n_chars + 1;
+
+                if (out->n_chars >= PAGER_IO_SIZE) {
+                    if (!pager_write_all(fd, out->chars, out->n_chars))
+                        RETURN(-3);
+                    out->n_chars = 0;
+                }
+            }
+        } else {
+            if (!pager_write_all(fd, out->chars, out->n_chars))
+                RETURN(-3);
+            out->n_chars = 0;
+
+            char last = '\n';
+            while (n_bytes < page->extent.n_bytes) {
+                size_t n_chunk = MIN(page->extent.n_bytes - n_bytes, (size_t) PAGER_IO_SIZE);
+
+                ssize_t n_read = pread(pager->fd, io, n_chunk, page->extent.offset + n_bytes);
+                if (n_read == -1 && errno == EINTR)
+                    continue;
+                if (n_read <= 0)
+                    RETURN(-3);
+
+                if (!pager_write_all(fd, io, n_read))
+                    RETURN(-3);
+
+                last = io[n_read - 1];
+                n_bytes += n_read;
+            }
+
+            // Every row ends in a newline once saved, same as without pages
+            if (last != '\n') {
+                ab_append(out, "\n", 1);
+                n_bytes++;
+            }
+        }
+
+        extents[p].offset = offset;
+        extents[p].n_bytes = n_bytes;
+        extents[p].n_rows = page->n_rows;
+        offset += n_bytes;
+    }
+
+    if (!pager_write_all(fd, out->chars, out->n_chars))
+        RETURN(-3);
+
+    if (close(fd) == -1) {
+        fd = -1;
+        RETURN(-3);
+    }
+    fd = -1;
+
+    if (rename(tmp_filename, filename) == -1)
+        RETURN(-4);
+
+    int new_fd = open(filename, O_RDONLY);
+    if (new_fd == -1)
+        RETURN(-5);
+
+    close(pager->fd);
+    pager->fd = new_fd;
+
+    // Everything is on disk now, so the overlay can go
+    for (int p = 0; p < pager->n_pages; p++) {
+        struct page *page = &pager->pages[p];
+        page->extent = extents[p];
+
+        if (page->dirty) {
+            for (int i = 0; i < page->n_rows; i++)
+                erow_free(page->rows[i]);
+
+            free(page->rows);
+            page->rows = NULL;
+            page->rows_cap = 0;
+
+            pager->mem_pages -= page->mem;
+            page->mem = 0;
+
+            page->dirty = false;
+        }
+    }
+
+    *bytes_written = offset;
+
+END:
+    if (fd != -1) {
+        close(fd);
+        unlink(tmp_filename);
+    }
+
+    free(io);
+    ab_free(out);
+    free(extents);
+    free(tmp_filename);
+
+    return errcode;
+}
+
+size_t pager_mem_used(struct pager *pager) {
+    return sizeof(struct page) * pager->pages_cap + pager->mem_pages
+        + pager->buffer->slab->n_bytes_reserved;
+}
+
+void pager_free(struct pager *pager) {
+    for (int p = 0; p < pager->n_pages; p++) {
+        free(pager->pages[p].rows);
+
+        if (pager->pages[p].slab)
+            slab_free(pager->pages[p].slab);
+    }
+
+    free(pager->pages);
+    close(pager->fd);
+    free(pager);
+}
+
+/*****************************************************************************/
+
+static void pager_lru_unlink(struct pager *pager, int p) {
+    struct page *page = &pager->pages[p];
+
+    if (page->lru_prev != -1) pager->pages[page->lru_prev].lru_next = page->lru_next;
+    else pager->lru_head = page->lru_next;
+
+    if (page->lru_next != -1) pager->pages[page->lru_next].lru_prev = page->lru_prev;
+    else pager->lru_tail = page->lru_prev;
+
+    page->lru_prev = page->lru_next = -1;
+}
+
+static void pager_lru_push(struct pager *pager, int p) {
+    struct page *page = &pager->pages[p];
+
+    page->lru_prev = -1;
+    page->lru_next = pager->lru_head;
+
+    if (pager->lru_head != -1) pager->pages[pager->lru_head].lru_prev = p;
+    else pager->lru_tail = p;
+
+    pager->lru_head = p;
+}
+
+static void pager_evict(struct pager *pager, int p) {
+    struct page *page = &pager->pages[p];
+
+    pager_lru_unlink(pager, p);
+
+    free(page->rows);
+    page->rows = NULL;
+    page->rows_cap = 0;
+
+    slab_free(page->slab);
+    page->slab = NULL;
+
+    pager->mem_pages -= page->mem;
+    page->mem = 0;
+
+    pager->n_evictions++;
+}
+
+// The most recently used page is always kept, so that a caller holding a row
+// from it can look up one more without it going away
+static void pager_make_room(struct pager *pager, size_t needed) {
+    while (pager_mem_used(pager) + needed > pager->mem_limit
+           && pager->lru_tail != -1 && pager->lru_tail != pager->lru_head)
+        pager_evict(pager, pager->lru_tail);
+}
+
+static void pager_load(struct pager *pager, int p) {
+    struct page *page = &pager->pages[p];
+    size_t n_bytes = page->extent.n_bytes;
+
+    pager_make_room(pager, n_bytes * 2 + page->n_rows * (sizeof(struct erow) + 16));
+
+    char *bytes = malloc(MAX(n_bytes, 1));
+    size_t n_read = 0;
+    while (n_read < n_bytes) {
+        ssize_t n = pread(pager->fd, bytes + n_read, n_bytes - n_read, page->extent.offset + n_read);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        n_read += n;
+    }
+
+    page->slab = slab_create();
+    page->rows_cap = MAX(page->n_rows, 1);
+    page->rows = malloc(sizeof(struct erow *) * page->rows_cap);
+
+    // Should the file have changed under us, pad or cut to the indexed count
+    char *c = bytes, *end = bytes + n_read;
+    for (int i = 0; i < page->n_rows; i++) {
+        char *newline = (c < end ? memchr(c, '\n', end - c) : NULL);
+        char *line_end = newline ? newline : end;
+
+        page->rows[i] = erow_create_in(page->slab, c, line_end - c, pager->buffer);
+        c = (newline ? newline + 1 : end);
+    }
+
+    free(bytes);
+
+    page->mem = page->slab->n_bytes_reserved + sizeof(struct erow *) * page->rows_cap;
+    pager->mem_pages += page->mem;
+    pager->n_loads++;
+
+    pager_lru_push(pager, p);
+}
+
+// Moves a resident clean page into the overlay by copying its rows into the
+// buffer's slab, where edits expect them to live
+static void pager_adopt(struct pager *pager, int p) {
+    struct page *page = &pager->pages[p];
+
+    for (int i = 0; i < page->n_rows; i++) {
+        struct erow *erow = page->rows[i];
+        page->rows[i] = erow_create(erow->chars, erow->n_chars, pager->buffer);
+    }
+
+    pager_lru_unlink(pager, p);
+
+    slab_free(page->slab);
+    page->slab = NULL;
+
+    pager->mem_pages -= page->mem;
+    page->mem = sizeof(struct erow *) * page->rows_cap;
+    pager->mem_pages += page->mem;
+
+    page->dirty = true;
+}
+
+// Moves page p into the edit overlay, with room for extra more bytes, unless
+// that would take the editor over its memory limit
+static bool pager_make_dirty(struct pager *pager, int p, size_t extra) {
+    struct page *page = &pager->pages[p];
+
+    if (page->dirty && extra == 0)
+        return true;
+
+    size_t needed = extra;
+    if (!page->dirty)
+        needed += page->extent.n_bytes * 2 + page->n_rows * (sizeof(struct erow) + 16);
+
+    pager_make_room(pager, needed);
+    if (pager_mem_used(pager) + needed > pager->mem_limit)
+        return false;
+
+    if (!page->dirty) {
+        if (page->rows == NULL)
+            pager_load(pager, p);
+        pager_adopt(pager, p);
+    }
+
+    return true;
+}
+
+// Finds the last page starting at or before row at, which skips over pages
+// left empty by deletions
+static int pager_find(struct pager *pager, int at) {
+    if (pager->n_pages == 0 || at < 0)
+        return -1;
+
+    if (at >= pager_n_rows(pager))
+        return -1;
+
+    struct page *hint = &pager->pages[pager->last_page];
+    if (hint->first_row <= at && at < hint->first_row + hint->n_rows)
+        return pager->last_page;
+
+    int lo = 0, hi = pager->n_pages - 1;
+    while (lo < hi) {
+        int mid = lo + (hi - lo + 1) / 2;
+
+        if (pager->pages[mid].first_row <= at) lo = mid;
+        else hi = mid - 1;
+    }
+
+    pager->last_page = lo;
+    return lo;
+}
+
+static void pager_shift(struct pager *pager, int p, int by) {
+    for (int q = p + 1; q < pager->n_pages; q++)
+        pager->pages[q].first_row += by;
+}
@@ -0,0 +1,330 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "erow.h"
+#include "reload.h"
+#include "utils.h"
+#include "words.h"
+
+// Past this many differing lines, whatever is left between the common prefix
+// and suffix is simply replaced
+#define RELOAD_MAX_D 2048
+
+struct reload_line {
+    const char *chars;
+    size_t n_chars;
+    uint64_t hash;
+};
+
+struct reload_hunk {
+    int old_at, n_old;
+    int new_at, n_new;
+};
+
+struct reload_diff {
+    struct reload_line *old_lines, *new_lines;
+
+    struct reload_hunk *hunks;
+    int n_hunks, hunks_cap;
+};
+
+static uint64_t reload_hash(const char *chars, size_t n_chars) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < n_chars; i++)
+        hash = (hash ^ (unsigned char) chars[i]) * 1099511628211ULL;
+
+    return hash;
+}
+
+static bool reload_line_eq(struct reload_line *a, struct reload_line *b) {
+    return a->hash == b->hash && a->n_chars == b->n_chars && memcmp(a->chars, b->chars, a->n_chars) == 0;
+}
+
+// Splits the file the same way the loader does
+static struct reload_line *reload_split(const char *chars, size_t n_chars, int *n_lines) {
+    int cap = 64;
+    struct reload_line *lines = malloc(sizeof(struct reload_line) * cap);
+    *n_lines = 0;
+
+    for (const char *c = chars, *end = chars + n_chars; c < end;) {
+        const char *newline = memchr(c, '\n', end - c);
+        const char *line_end = newline ? newline : end;
+
+        if (*n_lines == cap)
+            lines = realloc(lines, sizeof(struct reload_line) * (cap *= 2));
+
+        lines[*n_lines].chars = c;
+        lines[*n_lines].n_chars = line_end - c;
+        lines[*n_lines].hash = reload_hash(c, line_end - c);
+        (*n_lines)++;
+
+        c = (newline ? newline + 1 : end);
+    }
+
+    return lines;
+}
+
+static void reload_add_hunk(struct reload_diff *diff, int old_at, int n_old, int new_at, int n_new) {
+    // Edits come in one line at a time, backwards, so grow the last hunk
+    if (diff->n_hunks) {
+        struct reload_hunk *last = &diff->hunks[diff->n_hunks - 1];
+
+        if (last->old_at == old_at + n_old && last->new_at == new_at + n_new) {
+            last->old_at = old_at;
+            last->n_old += n_old;
+            last->new_at = new_at;
+            last->n_new += n_new;
+            return;
+        }
+    }
+
+    if (diff->n_hunks == diff->hunks_cap) {
+        diff->hunks_cap = MAX(diff->hunks_cap * 2, 16);
+        diff->hunks = realloc(diff->hunks, sizeof(struct reload_hunk) * diff->hunks_cap);
+    }
+
+    diff->hunks[diff->n_hunks++] = (struct reload_hunk) { old_at, n_old, new_at, n_new };
+}
+
+// Myers' O(ND) diff of old_lines[a0, a1) against new_lines[b0, b1). Gives
+// up and returns false once more than RELOAD_MAX_D edits would be needed.
+static bool reload_myers(struct reload_diff *diff, int a0, int a1, int b0, int b1) {
+    int n = a1 - a0, m = b1 - b0;
+    int max_d = MIN(n + m, RELOAD_MAX_D);
+    int offset = max_d + 1;
+
+    int *v = calloc(2 * offset + 1, sizeof(int));
+    int **trace = malloc(sizeof(int *) * (max_d + 1));
+    int n_trace = 0, d_found = -1;
+
+    for (int d = 0; d <= max_d && d_found == -1; d++) {
+        trace[n_trace++] = malloc(sizeof(int) * (2 * d + 1));
+        for (int k = -d; k <= d; k++)
+            trace[d][k + d] = v[k + offset];
+
+        for (int k = -d; k <= d; k += 2) {
+            int x;
+            if (k == -d || (k != d && v[k - 1 + offset] < v[k + 1 + offset])) x = v[k + 1 + offset];
+            else x = v[k - 1 + offset] + 1;
+
+            int y = x - k;
+            while (x < n && y < m && reload_line_eq(&diff->old_lines[a0 + x], &diff->new_lines[b0 + y]))
+                x++, y++;
+
+            v[k + offset] = x;
+            if (x >= n && y >= m) {
+                d_found = d;
+                break;
+            }
+        }
+    }
+
+    // Walk back from the end, each step is one inserted or deleted line
+    for (int d = d_found, x = n, y = m; d > 0; d--) {
+        int *prev_v = trace[d];
+        int k = x - y;
+
+        int prev_k;
+        if (k == -d || (k != d && prev_v[k - 1 + d] < prev_v[k + 1 + d])) prev_k = k + 1;
+        else prev_k = k - 1;
+
+        x = prev_v[prev_k + d];
+        y = x - prev_k;
+
+        if (prev_k == k + 1) reload_add_hunk(diff, a0 + x, 0, b0 + y, 1);
+        else reload_add_hunk(diff, a0 + x, 1, b0 + y, 0);
+    }
+
+    for (int d = 0; d < n_trace; d++)
+        free(trace[d]);
+    free(trace);
+    free(v);
+
+    return d_found != -1;
+}
+
+static int reload_map_row(struct reload_diff *diff, int row) {
+    int delta = 0;
+
+    for (int i = 0; i < diff->n_hunks; i++) {
+        struct reload_hunk *hunk = &diff->hunks[i];
+
+        if (row < hunk->old_at)
+            break;
+
+        if (row < hunk->old_at + hunk->n_old)
+            return hunk->new_at + MIN(row - hunk->old_at, MAX(hunk->n_new - 1, 0));
+
+        delta = (hunk->new_at + hunk->n_new) - (hunk->old_at + hunk->n_old);
+    }
+
+    return row + delta;
+}
+
+// The mark follows its line, unless that line changed
+static int reload_map_mark(struct reload_diff *diff, int mark) {
+    if (mark == -1)
+        return -1;
+
+    for (int i = 0; i < diff->n_hunks; i++) {
+        struct reload_hunk *hunk = &diff->hunks[i];
+
+        if (mark < hunk->old_at)
+            break;
+        if (mark < hunk->old_at + hunk->n_old)
+            return -1;
+    }
+
+    return reload_map_row(diff, mark);
+}
+
+// The file is read rather than mapped, as whatever changed it may still be
+// writing it, and a mapping of a file truncated under it faults on access.
+// Reads to the end, however far that is from the size fstat gave.
+static char *reload_read(int fd, size_t size_hint, size_t *n_chars) {
+    size_t cap = MAX(size_hint, 4096) + 1;
+    char *chars = malloc(cap);
+    *n_chars = 0;
+
+    for (;;) {
+        if (*n_chars == cap) {
+            cap *= 2;
+            chars = realloc(chars, cap);
+        }
+
+        ssize_t n_read = read(fd, chars + *n_chars, cap - *n_chars);
+        if (n_read == -1 && errno == EINTR)
+            continue;
+        if (n_read == -1) {
+            free(chars);
+            return NULL;
+        }
+        if (n_read == 0)
+            return chars;
+
+        *n_chars += n_read;
+    }
+}
+
+// Brings the buffer in line with the file on disk, only replacing the rows
+// that actually differ. The cursor and viewport stay on the same text.
+ERRCODE reload_buffer(struct buffer *buffer, int *n_changed, int *n_hunks) {
+    ERRCODE errcode = 0;
+
+    struct reload_diff diff = { NULL, NULL, NULL, 0, 0 };
+    char *chars = NULL;
+    size_t n_chars = 0;
+
+    if (buffer->pager || buffer->filename == NULL)
+        return -1;
+
+    int fd = open(buffer->filename, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1)
+        RETURN(-2);
+
+    chars = reload_read(fd, st.st_size, &n_chars);
+    if (chars == NULL)
+        RETURN(-3);
+
+    int n_old = buffer->n_rows, n_new;
+    diff.new_lines = reload_split(chars, n_chars, &n_new);
+
+    diff.old_lines = malloc(sizeof(struct reload_line) * MAX(n_old, 1));
+    for (int i = 0; i < n_old; i++) {
+        struct erow *erow = buffer->rows[i];
+        diff.old_lines[i] = (struct reload_line) { erow->chars, erow->n_chars, reload_hash(erow->chars, erow->n_chars) };
+    }
+
+    int prefix = 0, suffix = 0;
+    while (prefix < n_old && prefix < n_new && reload_line_eq(&diff.old_lines[prefix], &diff.new_lines[prefix]))
+        prefix++;
+    while (suffix < n_old - prefix && suffix < n_new - prefix
+           && reload_line_eq(&diff.old_lines[n_old - 1 - suffix], &diff.new_lines[n_new - 1 - suffix]))
+        suffix++;
+
+    if (!reload_myers(&diff, prefix, n_old - suffix, prefix, n_new - suffix)) {
+        diff.n_hunks = 0;
+        reload_add_hunk(&diff, prefix, n_old - suffix - prefix, prefix, n_new - suffix - prefix);
+    }
+
+    // Hunks were found back to front
+    for (int i = 0; i < diff.n_hunks / 2; i++) {
+        struct reload_hunk tmp = diff.hunks[i];
+        diff.hunks[i] = diff.hunks[diff.n_hunks - 1 - i];
+        diff.hunks[diff.n_hunks - 1 - i] = tmp;
+    }
+
+    int rows_cap = MAX(n_new, buffer->rows_cap);
+    struct erow **rows = malloc(sizeof(struct erow *) * MAX(rows_cap, 1));
+    int old_at = 0, n_rows = 0;
+    *n_changed = 0;
+
+    for (int i = 0; i < diff.n_hunks; i++) {
+        struct reload_hunk *hunk = &diff.hunks[i];
+
+        while (old_at < hunk->old_at)
+            rows[n_rows++] = buffer->rows[old_at++];
+
+        for (int j = 0; j < hunk->n_old; j++) {
+            struct erow *erow = buffer->rows[old_at++];
+
+            if (buffer->words)
+                words_count(buffer->words, erow->chars, erow->n_chars, -1);
+            erow_free(erow);
+        }
+
+        for (int j = hunk->new_at; j < hunk->new_at + hunk->n_new; j++) {
+            struct reload_line *line = &diff.new_lines[j];
+
+            if (buffer->words)
+                words_count(buffer->words, line->chars, line->n_chars, 1);
+            rows[n_rows++] = erow_create(line->chars, line->n_chars, buffer);
+        }
+
+        *n_changed += MAX(hunk->n_old, hunk->n_new);
+    }
+
+    while (old_at < n_old)
+        rows[n_rows++] = buffer->rows[old_at++];
+
+    buffer->n_table_frees += buffer->rows != NULL;
+    free(buffer->rows);
+
+    buffer->rows = rows;
+    buffer->n_rows = n_rows;
+    buffer->rows_cap = rows_cap;
+    buffer->n_table_allocs++;
+
+    buffer->cy = reload_map_row(&diff, buffer->cy);
+    buffer->row_off = reload_map_row(&diff, buffer->row_off);
+    buffer->mark = reload_map_mark(&diff, buffer->mark);
+    *n_hunks = diff.n_hunks;
+
+    buffer->modified = false;
+    buffer->file_size = n_chars;
+    buffer->tail_partial = n_chars && chars[n_chars - 1] != '\n';
+    buffer->file_stat = st;
+
+END:
+    free(chars);
+
+    if (fd != -1)
+        close(fd);
+
+    free(diff.old_lines);
+    free(diff.new_lines);
+    free(diff.hunks);
+
+    return errcode;
+}
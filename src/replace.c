@@ -0,0 +1,172 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "erow.h"
+#include "replace.h"
+#include "slab.h"
+#include "utils.h"
+#include "words.h"
+
+#define REPLACE_MIN_PER_THREAD 16384
+
+// Rows are built off the main thread from a private slab, like the loader's,
+// to be merged into the buffer's once done. So are the words they add and
+// remove counted.
+struct replace_task {
+    struct buffer *buffer;
+    struct erow **rows, **new_rows;
+    int from, to;
+
+    const char *pattern, *with;
+    size_t n_pattern, n_with;
+
+    struct slab *slab;
+    struct words *added, *removed;
+    size_t n_replaced;
+};
+
+static const char *replace_find(const char *chars, size_t n_chars, const char *pattern, size_t n_pattern);
+static void *replace_run(void *arg);
+
+// Replaces pattern with with in rows from up to to, as one change. Returns how
+// many matches were replaced, and sets n_changed to the rows they were in.
+size_t replace_all(struct buffer *buffer, int from, int to, const char *pattern, const char *with,
+                   int *n_changed) {
+    size_t n_pattern = strlen(pattern), n_with = strlen(with);
+    int n_rows = 0;
+
+    *n_changed = 0;
+    if (n_pattern == 0 || to <= from)
+        return 0;
+
+    struct erow **rows = malloc(sizeof(struct erow *) * (to - from));
+    struct erow **new_rows = malloc(sizeof(struct erow *) * (to - from));
+    int *ats = malloc(sizeof(int) * (to - from));
+
+    // Compressed rows are only readable while their block is thawed, so those
+    // with a match are copied out of it first
+    for (int at = from; at < to; at++) {
+        if (buffer->cold) {
+            struct erow *erow = buffer_get_row(buffer, at);
+            if (replace_find(erow->chars, erow->n_chars, pattern, n_pattern) == NULL)
+                continue;
+
+            rows[n_rows] = buffer_edit_row(buffer, at);
+        } else rows[n_rows] = buffer->rows[at];
+
+        ats[n_rows++] = at;
+    }
+
+    int n_tasks = utils_n_threads(n_rows, REPLACE_MIN_PER_THREAD);
+    struct replace_task tasks[UTILS_MAX_THREADS];
+
+    for (int i = 0; i < n_tasks; i++) {
+        tasks[i] = (struct replace_task) {
+            buffer, rows, new_rows, (long) n_rows * i / n_tasks, (long) n_rows * (i + 1) / n_tasks,
+            pattern, with, n_pattern, n_with, slab_create(),
+            buffer->words ? words_create() : NULL, buffer->words ? words_create() : NULL, 0
+        };
+    }
+
+    utils_parallel(replace_run, tasks, sizeof(struct replace_task), n_tasks);
+
+    size_t n_replaced = 0;
+    for (int i = 0; i < n_tasks; i++) {
+        slab_merge(buffer->slab, tasks[i].slab);
+        n_replaced += tasks[i].n_replaced;
+
+        // Added first, so that no count drops below zero on the way
+        if (buffer->words) {
+            words_merge(buffer->words, tasks[i].added, 1);
+            words_merge(buffer->words, tasks[i].removed, -1);
+            words_free(tasks[i].added);
+            words_free(tasks[i].removed);
+        }
+    }
+
+    // Only the rows that changed are swapped in
+    for (int i = 0; i < n_rows; i++) {
+        if (new_rows[i] == NULL)
+            continue;
+
+        new_rows[*n_changed] = new_rows[i];
+        ats[(*n_changed)++] = ats[i];
+    }
+
+    buffer_swap_rows(buffer, ats, new_rows, *n_changed);
+
+    free(rows);
+    free(new_rows);
+    free(ats);
+
+    return n_replaced;
+}
+
+/*****************************************************************************/
+
+static const char *replace_find(const char *chars, size_t n_chars, const char *pattern, size_t n_pattern) {
+    if (n_chars < n_pattern)
+        return NULL;
+
+    const char *end = chars + n_chars - n_pattern + 1;
+    for (const char *c = chars; c < end; c++) {
+        c = memchr(c, pattern[0], end - c);
+        if (c == NULL)
+            return NULL;
+
+        if (memcmp(c + 1, pattern + 1, n_pattern - 1) == 0)
+            return c;
+    }
+
+    return NULL;
+}
+
+// Each new row is built in one go in scratch, which only ever grows
+static void *replace_run(void *arg) {
+    struct replace_task *task = arg;
+
+    char *scratch = NULL;
+    size_t scratch_cap = 0;
+
+    for (int i = task->from; i < task->to; i++) {
+        struct erow *erow = task->rows[i];
+        const char *chars = erow->chars, *end = chars + erow->n_chars;
+        const char *match = replace_find(chars, erow->n_chars, task->pattern, task->n_pattern);
+
+        task->new_rows[i] = NULL;
+        if (match == NULL)
+            continue;
+
+        size_t n_chars = 0;
+        while (match) {
+            size_t n_before = match - chars, n_needed = n_chars + n_before + task->n_with + (end - match);
+            if (n_needed > scratch_cap) {
+                scratch_cap = MAX(scratch_cap * 2, n_needed);
+                scratch = realloc(scratch, scratch_cap);
+            }
+
+            memcpy(scratch + n_chars, chars, n_before);
+            memcpy(scratch + n_chars + n_before, task->with, task->n_with);
+            n_chars += n_before + task->n_with;
+            task->n_replaced++;
+
+            chars = match + task->n_pattern;
+            match = replace_find(chars, end - chars, task->pattern, task->n_pattern);
+        }
+
+        memcpy(scratch + n_chars, chars, end - chars);
+        n_chars += end - chars;
+
+        task->new_rows[i] = erow_create_in(task->slab, scratch, n_chars, task->buffer);
+
+        if (task->added) {
+            words_count(task->removed, erow->chars, erow->n_chars, 1);
+            words_count(task->added, scratch, n_chars, 1);
+        }
+    }
+
+    free(scratch);
+    return NULL;
+}
@@ -0,0 +1,244 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slab.h"
+#include "utils.h"
+
+struct slab_chunk {
+    struct slab_chunk *next;
+};
+
+struct slab_large {
+    struct slab_large *prev, *next;
+    size_t size;
+};
+
+static const size_t slab_class_sizes[SLAB_N_CLASSES] = {
+    8, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+
+static int slab_class(size_t size) {
+    if (size <= 8) return 0;
+    if (size <= 16) return 1;
+
+    int p = 31 - __builtin_clz((unsigned) size - 1);
+    size_t half = ((size_t) 3) << (p - 1);
+
+    return 2 * (p - 4) + 2 + (size > half);
+}
+
+struct slab *slab_create(void) {
+    struct slab *slab = malloc(sizeof(struct slab));
+
+    slab->chunks = NULL;
+    slab->large = NULL;
+    memset(slab->free_lists, 0, sizeof(slab->free_lists));
+
+    slab->next = slab->end = NULL;
+    slab->chunk_size = SLAB_MIN_CHUNK_SIZE;
+
+    slab->n_bytes_payload = 0;
+    slab->n_bytes_reserved = 0;
+    slab->n_allocs = 0;
+    slab->n_allocs_total = slab->n_frees_total = 0;
+
+    return slab;
+}
+
+void *slab_alloc(struct slab *slab, size_t size) {
+    if (size == 0)
+        return NULL;
+
+    if (slab == NULL)
+        return malloc(size);
+
+    slab->n_bytes_payload += size;
+    slab->n_allocs++;
+    slab->n_allocs_total++;
+
+    if (size > SLAB_MAX_SIZE) {
+        struct slab_large *large = malloc(sizeof(struct slab_large) + size);
+
+        large->prev = NULL;
+        large->next = slab->large;
+        large->size = size;
+
+        if (slab->large) slab->large->prev = large;
+        slab->large = large;
+
+        slab->n_bytes_reserved += sizeof(struct slab_large) + size;
+        return large + 1;
+    }
+
+    int class = slab_class(size);
+    void **free_list = &slab->free_lists[class];
+    if (*free_list) {
+        void *ptr = *free_list;
+        *free_list = *(void **) ptr;
+
+        return ptr;
+    }
+
+    size_t class_size = slab_class_sizes[class];
+    if (slab->next == NULL || (size_t) (slab->end - slab->next) < class_size) {
+        size_t chunk_size = slab->chunk_size;
+        slab->chunk_size = MIN(chunk_size * 2, SLAB_CHUNK_SIZE);
+
+        struct slab_chunk *chunk = malloc(chunk_size);
+
+        chunk->next = slab->chunks;
+        slab->chunks = chunk;
+
+        // Keep the first object 8-byte aligned past the chunk header
+        slab->next = (char *) chunk + MAX(sizeof(struct slab_chunk), 8);
+        slab->end = (char *) chunk + chunk_size;
+
+        slab->n_bytes_reserved += chunk_size;
+    }
+
+    void *ptr = slab->next;
+    slab->next += class_size;
+
+    return ptr;
+}
+
+void *slab_realloc(struct slab *slab, void *ptr, size_t old_size, size_t new_size) {
+    if (slab == NULL) {
+        if (new_size == 0) {
+            free(ptr);
+            return NULL;
+        }
+
+        return realloc(ptr, new_size);
+    }
+
+    if (ptr == NULL)
+        return slab_alloc(slab, new_size);
+
+    if (new_size == 0) {
+        slab_dealloc(slab, ptr, old_size);
+        return NULL;
+    }
+
+    bool old_small = old_size <= SLAB_MAX_SIZE, new_small = new_size <= SLAB_MAX_SIZE;
+    if (old_small && new_small && slab_class(old_size) == slab_class(new_size)) {
+        slab->n_bytes_payload += new_size - old_size;
+        return ptr;
+    }
+
+    if (!old_small && !new_small) {
+        struct slab_large *large = (struct slab_large *) ptr - 1;
+        large = realloc(large, sizeof(struct slab_large) + new_size);
+
+        if (large->prev) large->prev->next = large;
+        else slab->large = large;
+        if (large->next) large->next->prev = large;
+
+        large->size = new_size;
+
+        slab->n_bytes_payload += new_size - old_size;
+        slab->n_bytes_reserved += new_size - old_size;
+        return large + 1;
+    }
+
+    void *new_ptr = slab_alloc(slab, new_size);
+    memcpy(new_ptr, ptr, MIN(old_size, new_size));
+    slab_dealloc(slab, ptr, old_size);
+
+    return new_ptr;
+}
+
+void slab_dealloc(struct slab *slab, void *ptr, size_t size) {
+    if (ptr == NULL)
+        return;
+
+    if (slab == NULL) {
+        free(ptr);
+        return;
+    }
+
+    slab->n_bytes_payload -= size;
+    slab->n_allocs--;
+    slab->n_frees_total++;
+
+    if (size > SLAB_MAX_SIZE) {
+        struct slab_large *large = (struct slab_large *) ptr - 1;
+
+        if (large->prev) large->prev->next = large->next;
+        else slab->large = large->next;
+        if (large->next) large->next->prev = large->prev;
+
+        slab->n_bytes_reserved -= sizeof(struct slab_large) + large->size;
+        free(large);
+        return;
+    }
+
+    void **free_list = &slab->free_lists[slab_class(size)];
+    *(void **) ptr = *free_list;
+    *free_list = ptr;
+}
+
+// Hands everything src owns over to dst and frees src. Whatever is left of
+// src's current chunk is given up rather than tracked.
+void slab_merge(struct slab *dst, struct slab *src) {
+    if (src->chunks) {
+        struct slab_chunk *last = src->chunks;
+        while (last->next) last = last->next;
+
+        last->next = dst->chunks;
+        dst->chunks = src->chunks;
+    }
+
+    if (src->large) {
+        struct slab_large *last = src->large;
+        while (last->next) last = last->next;
+
+        last->next = dst->large;
+        if (dst->large) dst->large->prev = last;
+        dst->large = src->large;
+    }
+
+    for (int i = 0; i < SLAB_N_CLASSES; i++) {
+        void *last = src->free_lists[i];
+        if (last == NULL) continue;
+
+        while (*(void **) last) last = *(void **) last;
+        *(void **) last = dst->free_lists[i];
+        dst->free_lists[i] = src->free_lists[i];
+    }
+
+    dst->n_bytes_payload += src->n_bytes_payload;
+    dst->n_bytes_reserved += src->n_bytes_reserved;
+    dst->n_allocs += src->n_allocs;
+    dst->n_allocs_total += src->n_allocs_total;
+    dst->n_frees_total += src->n_frees_total;
+
+    free(src);
+}
+
+void slab_reset(struct slab *slab) {
+    while (slab->chunks) {
+        struct slab_chunk *next = slab->chunks->next;
+        free(slab->chunks);
+        slab->chunks = next;
+    }
+
+    while (slab->large) {
+        struct slab_large *next = slab->large->next;
+        free(slab->large);
+        slab->large = next;
+    }
+
+    memset(slab->free_lists, 0, sizeof(slab->free_lists));
+    slab->next = slab->end = NULL;
+
+    slab->n_bytes_payload = 0;
+    slab->n_bytes_reserved = 0;
+    slab->n_allocs = 0;
+}
+
+void slab_free(struct slab *slab) {
+    slab_reset(slab);
+    free(slab);
+}
@@ -0,0 +1,197 @@
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "erow.h"
+#include "sort.h"
+#include "utils.h"
+
+#define SORT_MIN_PER_THREAD 16384
+#define SORT_INSERTION_MAX 32
+
+// 8 bytes of a row as a big-endian number compare like the bytes themselves,
+// so most comparisons never touch the row. They are taken past whatever all
+// the rows start with, timestamps in a log say, which would tell none apart.
+struct sort_key {
+    uint64_t prefix;
+    struct erow *erow;
+};
+
+struct sort_task {
+    struct erow **rows;
+    struct sort_key *keys, *tmp;
+    size_t from, mid, to;
+    size_t skip;
+};
+
+static size_t sort_common_prefix(struct erow **rows, int n_rows);
+static void *sort_run_chunk(void *arg);
+static void *sort_run_merge(void *arg);
+
+void sort_rows(struct erow **rows, int n_rows) {
+    if (n_rows < 2)
+        return;
+
+    int n_chunks = utils_n_threads(n_rows, SORT_MIN_PER_THREAD);
+
+    struct sort_key *keys = malloc(sizeof(struct sort_key) * n_rows);
+    struct sort_key *tmp = malloc(sizeof(struct sort_key) * n_rows);
+
+    // Each chunk is keyed and sorted on its own thread
+    size_t bounds[UTILS_MAX_THREADS + 1];
+    struct sort_task tasks[UTILS_MAX_THREADS];
+    size_t skip = sort_common_prefix(rows, n_rows);
+
+    for (int i = 0; i <= n_chunks; i++)
+        bounds[i] = (size_t) n_rows * i / n_chunks;
+
+    for (int i = 0; i < n_chunks; i++)
+        tasks[i] = (struct sort_task) { rows, keys, tmp, bounds[i], 0, bounds[i + 1], skip };
+
+    utils_parallel(sort_run_chunk, tasks, sizeof(struct sort_task), n_chunks);
+
+    // Then merged pairwise, half as many threads each round
+    for (int n_runs = n_chunks; n_runs > 1; n_runs = (n_runs + 1) / 2) {
+        int n_tasks = 0;
+
+        for (int i = 0; i < n_runs; i += 2) {
+            size_t to = i + 1 < n_runs ? bounds[i + 2] : bounds[i + 1];
+            tasks[n_tasks++] = (struct sort_task) { rows, keys, tmp, bounds[i], bounds[i + 1], to, skip };
+        }
+
+        utils_parallel(sort_run_merge, tasks, sizeof(struct sort_task), n_tasks);
+
+        struct sort_key *swap = keys;
+        keys = tmp;
+        tmp = swap;
+
+        for (int i = 0; i < n_tasks; i++)
+            bounds[i] = tasks[i].from;
+        bounds[n_tasks] = n_rows;
+    }
+
+    for (int i = 0; i < n_rows; i++)
+        rows[i] = keys[i].erow;
+
+    free(keys);
+    free(tmp);
+}
+
+void sort_reverse(struct erow **rows, int n_rows) {
+    for (int i = 0, j = n_rows - 1; i < j; i++, j--) {
+        struct erow *swap = rows[i];
+        rows[i] = rows[j];
+        rows[j] = swap;
+    }
+}
+
+// Drops rows equal to the one before them, like uniq(1). What is dropped
+// goes to dropped, and the number of rows kept is returned.
+int sort_unique(struct erow **rows, int n_rows, struct erow **dropped) {
+    int n_kept = 0, n_dropped = 0;
+
+    for (int i = 0; i < n_rows; i++) {
+        struct erow *last = n_kept ? rows[n_kept - 1] : NULL;
+        bool same = last && last->n_chars == rows[i]->n_chars &&
+                    memcmp(last->chars, rows[i]->chars, last->n_chars) == 0;
+
+        if (same) dropped[n_dropped++] = rows[i];
+        else rows[n_kept++] = rows[i];
+    }
+
+    return n_kept;
+}
+
+/*****************************************************************************/
+
+static size_t sort_common_prefix(struct erow **rows, int n_rows) {
+    size_t n = rows[0]->n_chars;
+
+    for (int i = 1; i < n_rows && n > 0; i++) {
+        size_t j = 0, max = MIN(n, rows[i]->n_chars);
+        while (j < max && rows[i]->chars[j] == rows[0]->chars[j])
+            j++;
+        n = j;
+    }
+
+    return n;
+}
+
+static uint64_t sort_prefix(const struct erow *erow, size_t skip) {
+    uint64_t prefix = 0;
+
+    for (size_t i = skip; i < skip + 8; i++)
+        prefix = prefix << 8 | (i < erow->n_chars ? (unsigned char) erow->chars[i] : 0);
+
+    return prefix;
+}
+
+static int sort_compare(const struct sort_key *a, const struct sort_key *b, size_t skip) {
+    if (a->prefix != b->prefix)
+        return a->prefix < b->prefix ? -1 : 1;
+
+    size_t n_a = a->erow->n_chars, n_b = b->erow->n_chars, n = MIN(n_a, n_b);
+    if (n > skip + 8) {
+        int diff = memcmp(a->erow->chars + skip + 8, b->erow->chars + skip + 8, n - skip - 8);
+        if (diff)
+            return diff;
+    }
+
+    return (n_a > n_b) - (n_a < n_b);
+}
+
+// Merges the sorted from..mid and mid..to of src into dst
+static void sort_merge(const struct sort_key *src, struct sort_key *dst, size_t from, size_t mid, size_t to,
+                       size_t skip) {
+    size_t i = from, j = mid, k = from;
+
+    while (i < mid && j < to)
+        dst[k++] = sort_compare(&src[j], &src[i], skip) < 0 ? src[j++] : src[i++];
+
+    memcpy(dst + k, src + i, sizeof(struct sort_key) * (mid - i));
+    k += mid - i;
+    memcpy(dst + k, src + j, sizeof(struct sort_key) * (to - j));
+}
+
+static void sort_mergesort(struct sort_key *keys, struct sort_key *tmp, size_t from, size_t to, size_t skip) {
+    if (to - from <= SORT_INSERTION_MAX) {
+        for (size_t i = from + 1; i < to; i++) {
+            struct sort_key key = keys[i];
+
+            size_t j = i;
+            for (; j > from && sort_compare(&key, &keys[j - 1], skip) < 0; j--)
+                keys[j] = keys[j - 1];
+            keys[j] = key;
+        }
+
+        return;
+    }
+
+    size_t mid = from + (to - from) / 2;
+    sort_mergesort(keys, tmp, from, mid, skip);
+    sort_mergesort(keys, tmp, mid, to, skip);
+
+    sort_merge(keys, tmp, from, mid, to, skip);
+    memcpy(keys + from, tmp + from, sizeof(struct sort_key) * (to - from));
+}
+
+static void *sort_run_chunk(void *arg) {
+    struct sort_task *task = arg;
+
+    for (size_t i = task->from; i < task->to; i++)
+        task->keys[i] = (struct sort_key) { sort_prefix(task->rows[i], task->skip), task->rows[i] };
+
+    sort_mergesort(task->keys, task->tmp, task->from, task->to, task->skip);
+
+    return NULL;
+}
+
+static void *sort_run_merge(void *arg) {
+    struct sort_task *task = arg;
+
+    sort_merge(task->keys, task->tmp, task->from, task->mid, task->to, task->skip);
+
+    return NULL;
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "erow.h"
+#include "pager.h"
+#include "slab.h"
+#include "stats.h"
+
+static void stats_add_rows(struct buffer_stats *stats, struct erow **rows, int n_rows);
+static void stats_add_slab(struct buffer_stats *stats, struct slab *slab);
+
+// Only resident pages are looked at in paged buffers
+void stats_buffer(struct buffer *buffer, struct buffer_stats *stats) {
+    memset(stats, 0, sizeof(struct buffer_stats));
+
+    stats->n_rows = buffer->n_rows;
+    stats->rows_cap = buffer->rows_cap;
+
+    if (buffer->pager) {
+        struct pager *pager = buffer->pager;
+
+        for (int i = 0; i < pager->n_pages; i++) {
+            struct page *page = &pager->pages[i];
+            if (page->rows == NULL)
+                continue;
+
+            stats_add_rows(stats, page->rows, page->n_rows);
+            if (page->slab) stats_add_slab(stats, page->slab);
+        }
+    } else stats_add_rows(stats, buffer->rows, buffer->n_rows);
+
+    stats_add_slab(stats, buffer->slab);
+
+    stats->n_bytes_overhead += sizeof(struct erow *) * (buffer->rows_cap - buffer->n_rows);
+    stats->n_allocs += buffer->n_table_allocs;
+    stats->n_frees += buffer->n_table_frees;
+    stats->n_reallocs += buffer->n_table_reallocs;
+}
+
+// Resident set size in bytes, 0 if it can't be told
+size_t stats_rss(void) {
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return 0;
+
+    size_t n_pages, n_resident;
+    if (fscanf(statm, "%zu %zu", &n_pages, &n_resident) != 2)
+        n_resident = 0;
+    fclose(statm);
+
+    return n_resident * sysconf(_SC_PAGESIZE);
+}
+
+/*****************************************************************************/
+
+static void stats_add_rows(struct buffer_stats *stats, struct erow **rows, int n_rows) {
+    for (int i = 0; i < n_rows; i++) {
+        stats->n_bytes_chars += rows[i]->n_chars;
+        stats->n_bytes_rchars += rows[i]->n_rchars;
+    }
+}
+
+static void stats_add_slab(struct buffer_stats *stats, struct slab *slab) {
+    stats->n_bytes_overhead += slab->n_bytes_reserved - slab->n_bytes_payload;
+    stats->n_allocs += slab->n_allocs_total;
+    stats->n_frees += slab->n_frees_total;
+}
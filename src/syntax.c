@@ -0,0 +1,214 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "erow.h"
+#include "slab.h"
+#include "syntax.h"
+#include "utils.h"
+
+// Lexer states a row can end in
+#define STATE_NORMAL 0
+#define STATE_MLCOMMENT 1
+
+static const char *c_filematch[] = { ".c", ".h", ".cpp", ".hpp", ".cc", NULL };
+static const char *c_keywords[] = {
+    "switch", "if", "while", "for", "break", "continue", "return", "else", "do", "goto",
+    "struct", "union", "typedef", "static", "enum", "class", "case", "default", "sizeof",
+    "const", "extern", "inline", "volatile", "#include", "#define", "#ifdef", "#ifndef",
+    "#endif", "#if", "#else",
+
+    "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|", "void|",
+    "bool|", "size_t|", "ssize_t|", "off_t|", "short|",
+    NULL
+};
+
+static const char *conf_filematch[] = { ".conf", ".cfg", ".ini", ".sh", ".yml", ".yaml", ".toml",
+                                        "Makefile", ".mk", NULL };
+static const char *conf_keywords[] = {
+    "if", "then", "else", "elif", "fi", "for", "while", "do", "done", "case", "esac",
+    "function", "return", "export", "local", "in",
+
+    "true|", "false|", "yes|", "no|", "on|", "off|",
+    NULL
+};
+
+static const struct syntax syntaxes[] = {
+    { "c", c_filematch, c_keywords, "//", "/*", "*/", SYNTAX_NUMBERS | SYNTAX_STRINGS },
+    { "conf", conf_filematch, conf_keywords, "#", NULL, NULL, SYNTAX_NUMBERS | SYNTAX_STRINGS },
+};
+
+const struct syntax *syntax_select(const char *filename) {
+    if (filename == NULL)
+        return NULL;
+
+    const char *slash = strrchr(filename, '/');
+    const char *base = slash ? slash + 1 : filename;
+    const char *ext = strrchr(base, '.');
+
+    for (size_t i = 0; i < sizeof(syntaxes) / sizeof(syntaxes[0]); i++) {
+        for (const char **match = syntaxes[i].filematch; *match; match++) {
+            bool is_ext = (*match)[0] == '.';
+
+            if ((is_ext && ext && strcmp(ext, *match) == 0) || (!is_ext && strcmp(base, *match) == 0))
+                return &syntaxes[i];
+        }
+    }
+
+    return NULL;
+}
+
+static bool syntax_is_separator(int c) {
+    return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];{}:", c) != NULL;
+}
+
+static bool syntax_starts_with(const char *chars, size_t n_chars, const char *prefix) {
+    size_t len = prefix ? strlen(prefix) : 0;
+    return len && len <= n_chars && strncmp(chars, prefix, len) == 0;
+}
+
+// Highlights the rendered text of erow starting in state, returns the state
+// it ends in
+static int syntax_highlight_row(const struct syntax *syntax, struct erow *erow, int state) {
+    if (erow->hl == NULL)
+        erow->hl = slab_alloc(erow->buffer->slab, erow->n_rchars);
+    if (erow->n_rchars)
+        memset(erow->hl, HL_NORMAL, erow->n_rchars);
+
+    const char *chars = erow->rchars;
+    size_t n = erow->n_rchars;
+
+    bool prev_sep = true;
+    char in_string = 0;
+    bool in_comment = state == STATE_MLCOMMENT;
+
+    const char *mcs = syntax->ml_comment_start, *mce = syntax->ml_comment_end;
+    size_t mcs_len = mcs ? strlen(mcs) : 0, mce_len = mce ? strlen(mce) : 0;
+
+    for (size_t i = 0; i < n;) {
+        char c = chars[i];
+        unsigned char prev_hl = i > 0 ? erow->hl[i - 1] : HL_NORMAL;
+
+        if (!in_string && !in_comment && syntax_starts_with(chars + i, n - i, syntax->sl_comment_start)) {
+            memset(erow->hl + i, HL_COMMENT, n - i);
+            break;
+        }
+
+        if (mcs_len && mce_len && !in_string) {
+            if (in_comment) {
+                erow->hl[i] = HL_MLCOMMENT;
+
+                if (syntax_starts_with(chars + i, n - i, mce)) {
+                    memset(erow->hl + i, HL_MLCOMMENT, mce_len);
+                    i += mce_len;
+                    in_comment = false;
+                    prev_sep = true;
+                } else i++;
+
+                continue;
+            } else if (syntax_starts_with(chars + i, n - i, mcs)) {
+                memset(erow->hl + i, HL_MLCOMMENT, mcs_len);
+                i += mcs_len;
+                in_comment = true;
+                continue;
+            }
+        }
+
+        if (syntax->flags & SYNTAX_STRINGS) {
+            if (in_string) {
+                erow->hl[i] = HL_STRING;
+
+                if (c == '\\' && i + 1 < n) {
+                    erow->hl[i + 1] = HL_STRING;
+                    i += 2;
+                    continue;
+                }
+
+                if (c == in_string)
+                    in_string = 0;
+
+                i++;
+                prev_sep = true;
+                continue;
+            } else if (c == '"' || c == '\'') {
+                in_string = c;
+                erow->hl[i++] = HL_STRING;
+                continue;
+            }
+        }
+
+        if (syntax->flags & SYNTAX_NUMBERS) {
+            if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) || (c == '.' && prev_hl == HL_NUMBER)) {
+                erow->hl[i++] = HL_NUMBER;
+                prev_sep = false;
+                continue;
+            }
+        }
+
+        if (prev_sep) {
+            const char **keyword;
+            for (keyword = syntax->keywords; *keyword; keyword++) {
+                size_t len = strlen(*keyword);
+                bool second = (*keyword)[len - 1] == '|';
+                if (second)
+                    len--;
+
+                if (len <= n - i && strncmp(chars + i, *keyword, len) == 0
+                    && syntax_is_separator(i + len < n ? chars[i + len] : '\0')) {
+                    memset(erow->hl + i, second ? HL_KEYWORD2 : HL_KEYWORD1, len);
+                    i += len;
+                    break;
+                }
+            }
+
+            if (*keyword) {
+                prev_sep = false;
+                continue;
+            }
+        }
+
+        prev_sep = syntax_is_separator(c);
+        i++;
+    }
+
+    return in_comment ? STATE_MLCOMMENT : STATE_NORMAL;
+}
+
+// Brings the highlighting of every row before upto up to date. Rows before
+// hl_from are known to be, and a row after it only needs redoing when it was
+// edited or the state it starts in changed.
+void syntax_update(struct buffer *buffer, int upto) {
+    if (buffer->syntax == NULL || buffer->pager || buffer->cold)
+        return;
+
+    upto = MIN(upto, buffer->n_rows);
+
+    int state = buffer->hl_from > 0 ? buffer->rows[buffer->hl_from - 1]->hl_out : STATE_NORMAL;
+
+    for (int at = buffer->hl_from; at < upto; at++) {
+        struct erow *erow = buffer->rows[at];
+
+        if (erow->hl_stale || erow->hl_in != state) {
+            erow->hl_in = state;
+            erow->hl_out = syntax_highlight_row(buffer->syntax, erow, state);
+            erow->hl_stale = false;
+        }
+
+        state = erow->hl_out;
+    }
+
+    buffer->hl_from = MAX(buffer->hl_from, upto);
+}
+
+int syntax_color(enum highlight hl) {
+    switch (hl) {
+        case HL_COMMENT:
+        case HL_MLCOMMENT: return 36;
+        case HL_KEYWORD1: return 33;
+        case HL_KEYWORD2: return 32;
+        case HL_STRING: return 35;
+        case HL_NUMBER: return 31;
+        default: return 39;
+    }
+}
@@ -1,4 +1,6 @@
 #include <errno.h>
+#include <poll.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,10 +14,10 @@
 #include "utils.h"
 
 static void terminal_disable_raw(void) {
-    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1)
+    if (tcsetattr(E.tty_fd, TCSAFLUSH, &E.orig_termios) == -1)
         die ("term_disable_raw");
 
-    write(STDIN_FILENO, "\x1b[?1049l", 8);
+    write(E.tty_fd, "\x1b[?1049l", 8);
 
     if (error_message) {
         write(STDERR_FILENO, error_message, strlen(error_message));
@@ -23,12 +25,14 @@ static void terminal_disable_raw(void) {
     }
 }
 
-static char terminal_read_char(void) {
-    char c;
-
+// Returns false if the editor asked for a redraw while waiting
+static bool terminal_read_char(char *c) {
     ssize_t read_return;
     do {
-        read_return = read(STDIN_FILENO, &c, 1);
+        read_return = read(E.tty_fd, c, 1);
+
+        if (read_return == 0 && editor_tick())
+            return false;
     } while(read_return == 0 || (read_return == -1 && errno == EINTR));
 
     if (read_return == -1) {
@@ -36,11 +40,11 @@ static char terminal_read_char(void) {
         exit(1);
     }
 
-    return c;
+    return true;
 }
 
 ERRCODE terminal_enable_raw(void) {
-    if (tcgetattr(STDIN_FILENO, &E.orig_termios) == -1)
+    if (tcgetattr(E.tty_fd, &E.orig_termios) == -1)
         return -1;
 
     struct termios raw = E.orig_termios;
@@ -52,20 +56,20 @@ ERRCODE terminal_enable_raw(void) {
     raw.c_cc[VTIME] = 1;
 
     atexit(terminal_disable_raw);
-    write(STDIN_FILENO, "\x1b[?1049h", 8);
+    write(E.tty_fd, "\x1b[?1049h", 8);
 
-    return tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+    return tcsetattr(E.tty_fd, TCSAFLUSH, &raw);
 }
 
 ERRCODE terminal_clear(void) {
-    if (write(STDOUT_FILENO, "\x1b[2J", 4) != 4) return -1;
-    if (write(STDOUT_FILENO, "\x1b[H", 3) != 3) return -1;
+    if (write(E.tty_fd, "\x1b[2J", 4) != 4) return -1;
+    if (write(E.tty_fd, "\x1b[H", 3) != 3) return -1;
     return 0;
 
 }
 
 ERRCODE terminal_cursor_visibility(enum cursor_visibility visibility) {
-    if (write(STDOUT_FILENO, (visibility ? "\x1b[?25l" : "\x1b[?25h"), 6) != 6)
+    if (write(E.tty_fd, (visibility ? "\x1b[?25l" : "\x1b[?25h"), 6) != 6)
         return -1;
 
     return 0;
@@ -74,14 +78,14 @@ ERRCODE terminal_cursor_visibility(enum cursor_visibility visibility) {
 ERRCODE terminal_get_win_size(int *row, int *col) {
     struct winsize ws;
 
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) != -1 && ws.ws_col != 0) {
+    if (ioctl(E.tty_fd, TIOCGWINSZ, &ws) != -1 && ws.ws_col != 0) {
         *row = ws.ws_row - 2;
         *col = ws.ws_col;
 
         return 0;
     } else {
         // Fallback implementation
-        if (write(STDOUT_FILENO, "\x1b[999C\x1b[999B", 12) != 12) return -1;
+        if (write(E.tty_fd, "\x1b[999C\x1b[999B", 12) != 12) return -1;
 
         int _row, _col;
         ERRCODE get_err = terminal_get_cursor_pos(&_row, &_col);
@@ -97,10 +101,10 @@ ERRCODE terminal_get_win_size(int *row, int *col) {
 ERRCODE terminal_get_cursor_pos(int *row, int *col) {
     char buf[16];
 
-    if (write(STDOUT_FILENO, "\x1b[6n", 4) != 4) return -1;
+    if (write(E.tty_fd, "\x1b[6n", 4) != 4) return -1;
 
     for (int i = 0; i < (int) sizeof(buf); i++) {
-        if (read(STDIN_FILENO, buf+i, 1) == 0 || buf[i] == 'R') {
+        if (read(E.tty_fd, buf+i, 1) == 0 || buf[i] == 'R') {
             buf[i] = '\0';
             break;
         }
@@ -118,18 +122,20 @@ ERRCODE terminal_set_cursor_pos(int row, int col) {
     int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dH", row, col);
     len = (len >= (int) sizeof(buf) ? (int) sizeof(buf) - 1 : len);
 
-    if ((int) write(STDOUT_FILENO, buf, len) != len) return -1;
+    if ((int) write(E.tty_fd, buf, len) != len) return -1;
     return 0;
 }
 
 KEY terminal_read_key(void) {
-    char c = terminal_read_char();
+    char c;
+    if (!terminal_read_char(&c))
+        return NOP;
 
     if (c == '\x1b') {
         char buf[8] = { '\0' };
 
         for (int i = 0; i < (int) sizeof(buf); i++) {
-            if (read(STDIN_FILENO, buf+i, 1) == 0) {
+            if (read(E.tty_fd, buf+i, 1) == 0) {
                 if (i == 0) return ESCAPE;
                 else break;
             }
@@ -185,6 +191,13 @@ KEY terminal_read_key(void) {
     return (KEY) c;
 }
 
+// Whether a key is waiting to be read, without waiting for one
+bool terminal_key_pending(void) {
+    struct pollfd pollfd = { E.tty_fd, POLLIN, 0 };
+
+    return poll(&pollfd, 1, 0) == 1;
+}
+
 // IWYU pragma: no_include <bits/termios-c_cc.h>
 // IWYU pragma: no_include <bits/termios-c_cflag.h>
 // IWYU pragma: no_include <bits/termios-c_iflag.h>
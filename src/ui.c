@@ -1,3 +1,4 @@
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -6,66 +7,212 @@
 #include <unistd.h>
 
 #include "buffer.h"
+#include "cold.h"
+#include "intern.h"
 #include "erow.h"
 #include "kilo.h"
-#include "terminal.h"
+#include "loader.h"
+#include "pager.h"
+#include "syntax.h"
 #include "ui.h"
 #include "utils.h"
 
 static void ui_draw_rows(struct append_buf *draw_buffer);
+static void ui_draw_row(struct append_buf *line, int y);
+static void ui_show_row(struct append_buf *draw_buf, int y, struct append_buf *line, bool erase);
+static void ui_scroll_rows(struct append_buf *draw_buf, int by);
+static void ui_forget_rows(int from, int to);
+static void ui_draw_highlighted(struct append_buf *draw_buf, struct erow *erow, int from, int len);
 static void ui_draw_statusbar(struct append_buf *draw_buffer);
 static void ui_draw_messagebar(struct append_buf *draw_buffer);
 
+// What the screen showed after the last draw, a line per row and then the
+// status and message bars, so that only rows that changed are sent again.
+// NULL rows are to be drawn in any case.
+static struct {
+    struct append_buf **rows;
+    int n_rows, n_cols;
+
+    struct buffer *buffer;
+    int row_off;
+} shown;
+
+// A resize can come in halfway through drawing
+static volatile sig_atomic_t drawing;
+
 void ui_draw_screen(void) {
-    if (terminal_cursor_visibility(CURSOR_HIDDEN) == -1)
-        die("term_cursor_hidden");
+    // Nothing is shown halfway through a batch of edits
+    if (E.current_buf->n_open || drawing)
+        return;
+
+    drawing = 1;
 
-    struct append_buf *draw_buf = ab_create();
+    // All in one write, the cursor hidden while rows are drawn under it
+    struct append_buf *draw_buf = ab_create(), *line;
+    ab_append(draw_buf, "\x1b[?25l", 6);
 
     ui_draw_rows(draw_buf);
-    ui_draw_statusbar(draw_buf);
-    ui_draw_messagebar(draw_buf);
 
-    write(STDIN_FILENO, draw_buf->chars, draw_buf->n_chars);
+    line = ab_create();
+    ui_draw_statusbar(line);
+    ui_show_row(draw_buf, shown.n_rows, line, false);
+
+    line = ab_create();
+    ui_draw_messagebar(line);
+    ui_show_row(draw_buf, shown.n_rows + 1, line, true);
+
+    char pos[32];
+    int len = snprintf(pos, sizeof(pos), "\x1b[%d;%dH\x1b[?25h",
+                       E.current_buf->cy - E.current_buf->row_off + 1,
+                       E.current_buf->rx - E.current_buf->col_off + 1);
+    ab_append(draw_buf, pos, len);
+
+    write(E.tty_fd, draw_buf->chars, draw_buf->n_chars);
     ab_free(draw_buf);
 
-    int row_pos = E.current_buf->cy - E.current_buf->row_off + 1;
-    int col_pos = E.current_buf->rx - E.current_buf->col_off + 1;
-    if (terminal_set_cursor_pos(row_pos, col_pos) == -1)
-        die("term_set_cursor_pos");
+    drawing = 0;
+}
+
+// Only the message bar, which stays live while the rest is held back
+void ui_draw_message(void) {
+    struct append_buf *draw_buf = ab_create(), *line = ab_create();
 
-    if (terminal_cursor_visibility(CURSOR_SHOWN) == -1)
-        die("term_cursor_hidden");
+    ui_draw_messagebar(line);
+    ui_show_row(draw_buf, E.screenrows + 1, line, true);
+
+    write(E.tty_fd, draw_buf->chars, draw_buf->n_chars);
+    ab_free(draw_buf);
 }
 
 static void ui_draw_rows(struct append_buf *draw_buf) {
-    terminal_set_cursor_pos(1, 1);
-    for (int y = 0; y < E.screenrows; y++) {
-        bool in_file = (y < E.current_buf->n_rows - E.current_buf->row_off);
-        bool no_file = (E.current_buf->filename == NULL && E.current_buf->n_rows == 0);
+    struct buffer *buffer = E.current_buf;
+    syntax_update(buffer, buffer->row_off + E.screenrows);
+
+    if (shown.n_rows != E.screenrows || shown.n_cols != E.screencols) {
+        if (shown.rows) ui_forget_rows(0, shown.n_rows + 2);
+        free(shown.rows);
+
+        shown.n_rows = MAX(E.screenrows, 0);
+        shown.n_cols = E.screencols;
+        shown.rows = calloc(shown.n_rows + 2, sizeof(*shown.rows));
+    } else if (shown.buffer == buffer && shown.row_off != buffer->row_off) {
+        ui_scroll_rows(draw_buf, buffer->row_off - shown.row_off);
+    }
+
+    shown.buffer = buffer;
+    shown.row_off = buffer->row_off;
+
+    for (int y = 0; y < shown.n_rows; y++) {
+        struct append_buf *line = ab_create();
+        ui_draw_row(line, y);
+        ui_show_row(draw_buf, y, line, true);
+    }
+}
+
+static void ui_draw_row(struct append_buf *line, int y) {
+    bool in_file = (y < E.current_buf->n_rows - E.current_buf->row_off);
+    bool no_file = (E.current_buf->filename == NULL && E.current_buf->n_rows == 0);
+
+    if (in_file) {
+        struct erow *crow = buffer_get_row(E.current_buf, y + E.current_buf->row_off);
+
+        int len = (int) crow->n_rchars - E.current_buf->col_off;
+        len = MIN(len, E.screencols);
+
+        if (len > 0 && crow->hl && !crow->hl_stale)
+            ui_draw_highlighted(line, crow, E.current_buf->col_off, len);
+        else if (len > 0)
+            ab_append(line, crow->rchars + E.current_buf->col_off, len);
+    } else if (no_file && y == E.screenrows / 2) {
+        char welcome[64];
+        int len = snprintf(welcome, sizeof(welcome),
+                           "Welcome to kilo! -- %s", STRINGIZE(KILO_COMMIT_HASH));
+
+        int padding = (E.screencols - len) / 2;
+        for (int i = 0; i < padding; i++)
+            ab_append(line, (i == 0 ? "~" : " "), 1);
+
+        ab_append(line, welcome, len);
+    } else ab_append(line, "~", 1);
+}
+
+// Sends the line unless the row already shows it, and keeps it for next time
+static void ui_show_row(struct append_buf *draw_buf, int y, struct append_buf *line, bool erase) {
+    bool kept = shown.rows && y < shown.n_rows + 2 && shown.n_rows == E.screenrows;
+    struct append_buf *old = kept ? shown.rows[y] : NULL;
+
+    if (old && old->n_chars == line->n_chars &&
+        (line->n_chars == 0 || memcmp(old->chars, line->chars, line->n_chars) == 0)) {
+        ab_free(line);
+        return;
+    }
+
+    char pos[16];
+    int len = snprintf(pos, sizeof(pos), "\x1b[%d;1H", y + 1);
+    ab_append(draw_buf, pos, len);
+    ab_append(draw_buf, line->chars, line->n_chars);
+    if (erase) ab_append(draw_buf, "\x1b[K", 3);
+
+    if (old) ab_free(old);
+    if (kept) shown.rows[y] = line;
+    else ab_free(line);
+}
+
+// When the viewport moves by less than a screen, the terminal shifts what it
+// already shows within a scroll region above the status bar, leaving only the
+// rows that come into view to be sent
+static void ui_scroll_rows(struct append_buf *draw_buf, int by) {
+    int n = abs(by), n_kept = shown.n_rows - n;
+    if (n_kept <= 0) {
+        ui_forget_rows(0, shown.n_rows);
+        return;
+    }
+
+    char escape[32];
+    int len = snprintf(escape, sizeof(escape), "\x1b[1;%dr\x1b[%d;1H",
+                       shown.n_rows, (by > 0 ? shown.n_rows : 1));
+    ab_append(draw_buf, escape, len);
 
-        if (in_file) {
-            struct erow *crow = E.current_buf->rows[y + E.current_buf->row_off];
+    // Line feeds at the bottom of the region scroll it up, reverse index at
+    // the top scrolls it down
+    for (int i = 0; i < n; i++)
+        ab_append(draw_buf, (by > 0 ? "\n" : "\x1bM"), (by > 0 ? 1 : 2));
+    ab_append(draw_buf, "\x1b[r", 3);
 
-            size_t len = crow->n_rchars - E.current_buf->col_off;
-            len = MIN(len, (size_t) E.screencols);
-            len = MAX(len, 0);
+    if (by > 0) {
+        ui_forget_rows(0, n);
+        memmove(shown.rows, shown.rows + n, n_kept * sizeof(*shown.rows));
+        memset(shown.rows + n_kept, 0, n * sizeof(*shown.rows));
+    } else {
+        ui_forget_rows(n_kept, shown.n_rows);
+        memmove(shown.rows + n, shown.rows, n_kept * sizeof(*shown.rows));
+        memset(shown.rows, 0, n * sizeof(*shown.rows));
+    }
+}
 
-            ab_append(draw_buf, crow->rchars + E.current_buf->col_off, len);
-        } else if (no_file && y == E.screenrows / 2) {
-            char welcome[64];
-            int len = snprintf(welcome, sizeof(welcome),
-                               "Welcome to kilo! -- %s", STRINGIZE(KILO_COMMIT_HASH));
+static void ui_forget_rows(int from, int to) {
+    for (int y = from; y < to; y++) {
+        if (shown.rows[y]) ab_free(shown.rows[y]);
+        shown.rows[y] = NULL;
+    }
+}
 
-            int padding = (E.screencols - len) / 2;
-            for (int i = 0; i < padding; i++)
-                ab_append(draw_buf, (i == 0 ? "~" : " "), 1);
+// Text is appended in runs of the same color
+static void ui_draw_highlighted(struct append_buf *draw_buf, struct erow *erow, int from, int len) {
+    for (int i = from, end = from + len; i < end;) {
+        int color = syntax_color(erow->hl[i]), run = i + 1;
+        while (run < end && syntax_color(erow->hl[run]) == color)
+            run++;
 
-            ab_append(draw_buf, welcome, len);
-        } else ab_append(draw_buf, "~", 1);
+        char escape[16];
+        int escape_len = snprintf(escape, sizeof(escape), "\x1b[%dm", color);
 
-        ab_append(draw_buf, "\x1b[K\r\n", 5);
+        ab_append(draw_buf, escape, escape_len);
+        ab_append(draw_buf, erow->rchars + i, run - i);
+        i = run;
     }
+
+    ab_append(draw_buf, "\x1b[39m", 5);
 }
 
 static void ui_draw_statusbar(struct append_buf *draw_buf) {
@@ -79,21 +226,61 @@ static void ui_draw_statusbar(struct append_buf *draw_buf) {
     char *display = E.current_buf->filename ? E.current_buf->filename : "[NO NAME]";
     char *modified = E.current_buf->modified ? "(modified) " : "";
     int n_rows = E.current_buf->n_rows;
-    len = sprintf(buf, "%s %s-- %d lines", display, modified, n_rows);
-    memcpy(status_buf, buf, len);
+    len = snprintf(buf, sizeof(buf), "%s %s-- %d lines", display, modified, n_rows);
+
+    if (E.n_buffers > 1)
+        len += snprintf(buf + len, sizeof(buf) - len, " [%d/%d]", E.buffer_at + 1, E.n_buffers);
+
+    if (E.current_buf->follow)
+        len += snprintf(buf + len, sizeof(buf) - len, " [follow]");
+
+    if (E.current_buf->mark != -1)
+        len += snprintf(buf + len, sizeof(buf) - len, " [mark %d]", E.current_buf->mark + 1);
+
+    if (E.current_buf->pager) {
+        size_t mem_used = pager_mem_used(E.current_buf->pager);
+        len += snprintf(buf + len, sizeof(buf) - len, " [paged %zu/%zu MiB]",
+                        mem_used >> 20, E.current_buf->pager->mem_limit >> 20);
+    }
+
+    if (E.current_buf->cold) {
+        struct cold *cold = E.current_buf->cold;
+        size_t n_lookups = MAX(cold->n_hits + cold->n_misses, 1);
+        size_t ratio = cold->n_bytes_data * 100 / MAX(cold->n_bytes_raw, 1);
+
+        len += snprintf(buf + len, sizeof(buf) - len, " [compressed to %zu%%, %zu%% hits]",
+                        ratio, cold->n_hits * 100 / n_lookups);
+    }
+
+    if (E.current_buf->intern) {
+        len += snprintf(buf + len, sizeof(buf) - len, " [%zu KiB shared]",
+                        E.current_buf->intern->n_bytes_saved >> 10);
+    }
+
+    if (E.current_buf->loader) {
+        size_t bytes_read, bytes_total;
+        loader_progress(E.current_buf->loader, &bytes_read, &bytes_total);
+
+        if (bytes_total)
+            len += snprintf(buf + len, sizeof(buf) - len, " (loading %d%%)",
+                            (int) (bytes_read * 100 / bytes_total));
+        else
+            len += snprintf(buf + len, sizeof(buf) - len, " (loading %zu KiB)", bytes_read / 1024);
+    }
+
+    len = MIN(len, (int) sizeof(buf) - 1);
+    memcpy(status_buf, buf, MIN(len, E.screencols));
 
     len = sprintf(buf, "%d:%d", E.current_buf->cy + 1, E.current_buf->rx + 1);
     memcpy(status_buf + E.screencols - len, buf, len);
 
     ab_append(draw_buf, status_buf, E.screencols);
-    ab_append(draw_buf, "\x1b[m\r\n", 5);
+    ab_append(draw_buf, "\x1b[m", 3);
 
     free(status_buf);
 }
 
 static void ui_draw_messagebar(struct append_buf *draw_buf) {
-    ab_append(draw_buf, "\x1b[K", 3);
-
     int len = strlen(E.message);
     if (len > E.screencols) len = E.screencols;
 
@@ -0,0 +1,347 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "cursor.h"
+#include "erow.h"
+#include "undo.h"
+#include "utils.h"
+
+static void undo_drop_redo(struct undo *undo);
+static int undo_run_start(struct undo *undo, int last);
+static int undo_run_end(struct undo *undo, int first);
+static bool undo_step_loaded(struct undo *undo, struct buffer *buffer, bool back);
+static void undo_trim(struct undo *undo);
+
+struct undo *undo_create(size_t mem_limit) {
+    struct undo *undo = malloc(sizeof(struct undo));
+
+    undo->entries = NULL;
+    undo->n_entries = undo->entries_cap = 0;
+    undo->n_done = undo->n_saved = 0;
+
+    undo->mem = 0;
+    undo->mem_limit = mem_limit;
+    undo->sealed = true;
+    undo->applying = false;
+    undo->sealed_cx = undo->sealed_cy = 0;
+
+    return undo;
+}
+
+// Typing or deleting one character right next to the last one extends it.
+// A word followed by a space is one step, the next word starts another. An
+// edit made after saving never joins one from before, or undoing and redoing
+// it would end up back at the saved state with the edit still in place.
+static bool undo_coalesce(struct undo *undo, const struct edit *edit) {
+    if (undo->n_done == 0 || undo->n_done == undo->n_saved || edit->n_chars != 1)
+        return false;
+
+    struct undo_entry *last = &undo->entries[undo->n_done - 1];
+    if (last->type != (int) edit->type || last->row != edit->row)
+        return false;
+
+    if (edit->type == EDIT_INSERT_CHARS && edit->at == last->at + last->n_chars) {
+        if (undo->sealed && !isspace(edit->chars[0]) && isspace(last->chars[last->n_chars - 1]))
+            return false;
+
+        last->chars = realloc(last->chars, last->n_chars + 1);
+        last->chars[last->n_chars++] = edit->chars[0];
+    } else if (edit->type == EDIT_DELETE_CHARS && edit->at + 1 == last->at) {
+        last->chars = realloc(last->chars, last->n_chars + 1);
+        memmove(last->chars + 1, last->chars, last->n_chars++);
+        last->chars[0] = edit->chars[0];
+        last->at--;
+    } else if (edit->type == EDIT_DELETE_CHARS && edit->at == last->at) {
+        last->chars = realloc(last->chars, last->n_chars + 1);
+        last->chars[last->n_chars++] = edit->chars[0];
+    } else return false;
+
+    undo->mem++;
+    return true;
+}
+
+void undo_record(struct undo *undo, const struct edit *edit) {
+    if (undo->applying)
+        return;
+
+    undo_drop_redo(undo);
+
+    if (undo_coalesce(undo, edit)) {
+        undo->sealed = false;
+        return;
+    }
+
+    if (undo->n_entries == undo->entries_cap) {
+        undo->entries_cap = MAX(undo->entries_cap * 2, 64);
+        undo->entries = realloc(undo->entries, sizeof(struct undo_entry) * undo->entries_cap);
+    }
+
+    struct undo_entry *entry = &undo->entries[undo->n_entries++];
+    undo->n_done = undo->n_entries;
+
+    entry->type = edit->type;
+    entry->row = edit->row;
+    entry->at = edit->at;
+
+    entry->chars = malloc(MAX(edit->n_chars, 1));
+    entry->n_chars = edit->n_chars;
+    if (edit->n_chars)
+        memcpy(entry->chars, edit->chars, edit->n_chars);
+
+    entry->cx = undo->sealed_cx;
+    entry->cy = undo->sealed_cy;
+    entry->step_start = undo->sealed;
+    undo->sealed = false;
+
+    undo->mem += sizeof(struct undo_entry) + edit->n_chars;
+    undo_trim(undo);
+}
+
+// Ends the current step, the next edit starts a new one with the cursor
+// where it is now
+void undo_seal(struct undo *undo, int cx, int cy) {
+    undo->sealed = true;
+    undo->sealed_cx = cx;
+    undo->sealed_cy = cy;
+}
+
+void undo_mark_saved(struct undo *undo) {
+    undo->n_saved = undo->n_done;
+    undo->sealed = true;
+}
+
+// Applies a run of n entries from undo_run_start or undo_run_end, or reverts
+// it going back. Row entries are applied as one replace of the rows, so the
+// rows after them move once for the whole run rather than once per row.
+static bool undo_apply(struct buffer *buffer, const struct undo_entry *run, int n, bool back) {
+    if (run->type == EDIT_INSERT_CHARS || run->type == EDIT_DELETE_CHARS) {
+        struct erow *erow = buffer_edit_row(buffer, run->row);
+        if (erow == NULL)
+            return false;
+
+        if ((run->type == EDIT_INSERT_CHARS) != back) erow_insert_chars(erow, run->chars, run->n_chars, run->at);
+        else erow_delete_chars(erow, run->n_chars, run->at);
+
+        return true;
+    }
+
+    int n_deleted = 0;
+    while (n_deleted < n && run[n_deleted].type == EDIT_DELETE_ROW)
+        n_deleted++;
+
+    int n_old = back ? n - n_deleted : n_deleted, n_new = n - n_old;
+    const struct undo_entry *added = back ? run : run + n_deleted;
+
+    struct erow **rows = malloc(sizeof(struct erow *) * MAX(n_new, 1));
+    for (int i = 0; i < n_new; i++)
+        rows[i] = erow_create(added[i].chars, added[i].n_chars, buffer);
+
+    bool replaced = buffer_replace_rows(buffer, run->row, n_old, rows, n_new);
+    free(rows);
+
+    return replaced;
+}
+
+// Undoes the last step. If an edit can't be undone, as can happen when a
+// paged buffer is out of memory, the history is given up on. Returns -3 if
+// the step reaches rows that are still loading.
+ERRCODE undo_step_back(struct undo *undo, struct buffer *buffer) {
+    if (undo->n_done == 0)
+        return -1;
+    if (!undo_step_loaded(undo, buffer, true))
+        return -3;
+
+    ERRCODE errcode = 0;
+    undo->applying = true;
+
+    int i = undo->n_done - 1;
+    for (;;) {
+        int first = undo_run_start(undo, i);
+        if (!undo_apply(buffer, &undo->entries[first], i - first + 1, true)) {
+            undo_clear(undo);
+            RETURN(-2);
+        }
+
+        i = first;
+        if (undo->entries[i].step_start || i == 0)
+            break;
+        i--;
+    }
+
+    undo->n_done = i;
+    cursor_set(buffer, undo->entries[i].cx, undo->entries[i].cy);
+
+END:
+    undo->applying = false;
+    undo->sealed = true;
+    buffer->modified = undo->n_done != undo->n_saved;
+
+    return errcode;
+}
+
+ERRCODE undo_step_forward(struct undo *undo, struct buffer *buffer) {
+    if (undo->n_done == undo->n_entries)
+        return -1;
+    if (!undo_step_loaded(undo, buffer, false))
+        return -3;
+
+    ERRCODE errcode = 0;
+    undo->applying = true;
+
+    struct undo_entry *entry;
+    do {
+        int end = undo_run_end(undo, undo->n_done);
+        if (!undo_apply(buffer, &undo->entries[undo->n_done], end - undo->n_done, false)) {
+            undo_clear(undo);
+            RETURN(-2);
+        }
+
+        undo->n_done = end;
+        entry = &undo->entries[end - 1];
+    } while (undo->n_done < undo->n_entries && !undo->entries[undo->n_done].step_start);
+
+    // Leave the cursor after whatever was redone last
+    if (entry->type == EDIT_INSERT_CHARS) cursor_set(buffer, entry->at + entry->n_chars, entry->row);
+    else if (entry->type == EDIT_DELETE_CHARS) cursor_set(buffer, entry->at, entry->row);
+    else cursor_set(buffer, 0, entry->row);
+
+END:
+    undo->applying = false;
+    undo->sealed = true;
+    buffer->modified = undo->n_done != undo->n_saved;
+
+    return errcode;
+}
+
+// For when the rows were replaced wholesale, and edits no longer line up
+void undo_clear(struct undo *undo) {
+    for (int i = 0; i < undo->n_entries; i++)
+        free(undo->entries[i].chars);
+
+    undo->n_entries = undo->n_done = 0;
+    undo->n_saved = -1;
+    undo->mem = 0;
+    undo->sealed = true;
+}
+
+void undo_free(struct undo *undo) {
+    undo_clear(undo);
+
+    free(undo->entries);
+    free(undo);
+}
+
+/*****************************************************************************/
+
+static void undo_drop_redo(struct undo *undo) {
+    if (undo->n_done == undo->n_entries)
+        return;
+
+    for (int i = undo->n_done; i < undo->n_entries; i++) {
+        undo->mem -= sizeof(struct undo_entry) + undo->entries[i].n_chars;
+        free(undo->entries[i].chars);
+    }
+
+    // The saved state can't be reached again
+    if (undo->n_saved > undo->n_done)
+        undo->n_saved = -1;
+
+    undo->n_entries = undo->n_done;
+    undo->sealed = true;
+}
+
+// Drops whole steps from the front until well under the limit, so the move
+// down of what remains happens rarely
+static void undo_trim(struct undo *undo) {
+    if (undo->mem <= undo->mem_limit)
+        return;
+
+    int n_dropped = 0;
+    while (n_dropped < undo->n_entries - 1 && undo->mem > undo->mem_limit / 4 * 3) {
+        undo->mem -= sizeof(struct undo_entry) + undo->entries[n_dropped].n_chars;
+        free(undo->entries[n_dropped].chars);
+        n_dropped++;
+
+        while (n_dropped < undo->n_entries - 1 && !undo->entries[n_dropped].step_start) {
+            undo->mem -= sizeof(struct undo_entry) + undo->entries[n_dropped].n_chars;
+            free(undo->entries[n_dropped].chars);
+            n_dropped++;
+        }
+    }
+
+    memmove(undo->entries, undo->entries + n_dropped, sizeof(struct undo_entry) * (undo->n_entries - n_dropped));
+    undo->n_entries -= n_dropped;
+    undo->n_done -= n_dropped;
+    undo->n_saved = (undo->n_saved >= n_dropped ? undo->n_saved - n_dropped : -1);
+
+    if (undo->n_entries)
+        undo->entries[0].step_start = true;
+}
+
+// Rows are deleted and inserted as buffer_splice_rows records them: rows
+// deleted one after another at the same row, then the new ones inserted from
+// that row on. A run like that within a step is undone and redone at once.
+static bool undo_is_row(const struct undo_entry *entry) {
+    return entry->type == EDIT_INSERT_ROW || entry->type == EDIT_DELETE_ROW;
+}
+
+// The first entry of the run that ends at last
+static int undo_run_start(struct undo *undo, int last) {
+    struct undo_entry *entries = undo->entries;
+    if (!undo_is_row(&entries[last]))
+        return last;
+
+    int i = last;
+    while (i > 0 && !entries[i].step_start && entries[i].type == EDIT_INSERT_ROW &&
+           entries[i - 1].type == EDIT_INSERT_ROW && entries[i - 1].row + 1 == entries[i].row)
+        i--;
+    while (i > 0 && !entries[i].step_start && entries[i - 1].type == EDIT_DELETE_ROW &&
+           entries[i - 1].row == entries[i].row)
+        i--;
+
+    return i;
+}
+
+// One past the last entry of the run that starts at first
+static int undo_run_end(struct undo *undo, int first) {
+    struct undo_entry *entries = undo->entries;
+    if (!undo_is_row(&entries[first]))
+        return first + 1;
+
+    int i = first + 1;
+    while (i < undo->n_entries && !entries[i].step_start && entries[i].type == EDIT_DELETE_ROW &&
+           entries[i - 1].type == EDIT_DELETE_ROW && entries[i - 1].row == entries[i].row)
+        i++;
+    while (i < undo->n_entries && !entries[i].step_start && entries[i].type == EDIT_INSERT_ROW &&
+           entries[i - 1].row + (entries[i - 1].type == EDIT_INSERT_ROW) == entries[i].row)
+        i++;
+
+    return i;
+}
+
+// A history kept while the rows were unloaded can go past the ones read back
+// in so far
+static bool undo_step_loaded(struct undo *undo, struct buffer *buffer, bool back) {
+    if (!buffer_is_loading(buffer))
+        return true;
+
+    // The entries of the step to undo or redo
+    int first = undo->n_done, end = undo->n_done;
+    if (back) {
+        do first--;
+        while (first > 0 && !undo->entries[first].step_start);
+    } else {
+        do end++;
+        while (end < undo->n_entries && !undo->entries[end].step_start);
+    }
+
+    for (int i = first; i < end; i++) {
+        if (undo->entries[i].row >= buffer->n_rows)
+            return false;
+    }
+
+    return true;
+}
@@ -1,9 +1,21 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
-#include "utils.h"
+#include "kilo.h"
 #include "terminal.h"
+#include "ui.h"
+#include "utils.h"
+
+// How often long running commands show their progress and check for a key to
+// cancel them
+#define UTILS_PROGRESS_NS (100 * 1000000LL)
 
 void die(const char *context) {
     terminal_clear();
@@ -12,19 +24,85 @@ void die(const char *context) {
     exit(1);
 }
 
+// Nanoseconds on a clock that only goes forward
+int64_t utils_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Called as a long running command goes. Every so often shows the message,
+// unless a key was pressed, which is read and true returned to cancel.
+bool utils_progress(int64_t *shown_at, const char *fmt, ...) {
+    if (utils_now() - *shown_at < UTILS_PROGRESS_NS)
+        return false;
+
+    if (terminal_key_pending()) {
+        terminal_read_key();
+        return true;
+    }
+
+    char message[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(message, sizeof(message), fmt, ap);
+    va_end(ap);
+
+    editor_set_message("%s", message);
+    ui_draw_message();
+    *shown_at = utils_now();
+
+    return false;
+}
+
+// One thread per core, as long as each gets at least min_per_thread items
+int utils_n_threads(int n_items, int min_per_thread) {
+    long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return CLAMP((int) MIN(n_cpus, n_items / min_per_thread), 1, UTILS_MAX_THREADS);
+}
+
+// Calls run on each of n_tasks tasks, task_size bytes apart, each on its own
+// thread. The first runs on the calling thread, and so do any that a thread
+// couldn't be started for.
+void utils_parallel(void *(*run)(void *), void *tasks, size_t task_size, int n_tasks) {
+    pthread_t threads[UTILS_MAX_THREADS];
+    char *task = tasks;
+    int n_started = 1;
+
+    for (; n_started < n_tasks; n_started++) {
+        if (pthread_create(&threads[n_started], NULL, run, task + n_started * task_size) != 0)
+            break;
+    }
+
+    run(task);
+
+    for (int i = 1; i < n_tasks; i++) {
+        if (i < n_started) pthread_join(threads[i], NULL);
+        else run(task + i * task_size);
+    }
+}
+
 /*****************************************************************************/
 
+size_t ab_n_allocs, ab_n_frees, ab_n_reallocs;
+
 struct append_buf *ab_create(void) {
     size_t buf_size = sizeof(struct append_buf);
     struct append_buf *sb = (struct append_buf *) malloc(buf_size);
 
     sb->chars = NULL;
     sb->n_chars = 0;
+    ab_n_allocs++;
 
     return sb;
 }
 
 void ab_append(struct append_buf *sb, const char *chars, int n_chars) {
+    if (sb->chars) ab_n_reallocs++;
+    else ab_n_allocs++;
+
     sb->chars = realloc(sb->chars, sb->n_chars + n_chars);
 
     memcpy(sb->chars + sb->n_chars, chars, n_chars);
@@ -32,6 +110,8 @@ void ab_append(struct append_buf *sb, const char *chars, int n_chars) {
 }
 
 void ab_free(struct append_buf *sb) {
+    ab_n_frees += 1 + (sb->chars != NULL);
+
     free(sb->chars);
     free(sb);
 }
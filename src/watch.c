@@ -0,0 +1,92 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+
+#define WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF)
+#endif
+
+#include "watch.h"
+
+struct watch {
+    char *filename;
+
+    int fd, wd;
+    struct stat st;
+};
+
+struct watch *watch_create(const char *filename) {
+    struct watch *watch = malloc(sizeof(struct watch));
+
+    size_t filename_len = strlen(filename);
+    watch->filename = malloc(filename_len + 1);
+    memcpy(watch->filename, filename, filename_len + 1);
+
+    watch->fd = watch->wd = -1;
+    if (stat(filename, &watch->st) == -1)
+        memset(&watch->st, 0, sizeof(struct stat));
+
+#ifdef __linux__
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->fd != -1)
+        watch->wd = inotify_add_watch(watch->fd, filename, WATCH_MASK);
+#endif
+
+    return watch;
+}
+
+bool watch_poll(struct watch *watch) {
+    bool changed = false;
+
+#ifdef __linux__
+    if (watch->fd != -1) {
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+        ssize_t n_read;
+        while ((n_read = read(watch->fd, events, sizeof(events))) > 0) {
+            changed = true;
+
+            for (char *c = events; c < events + n_read;) {
+                struct inotify_event *event = (struct inotify_event *) c;
+
+                // Replaced by a rename or deleted, the new file is picked up below
+                if (event->mask & IN_IGNORED)
+                    watch->wd = -1;
+
+                c += sizeof(struct inotify_event) + event->len;
+            }
+        }
+
+        if (watch->wd == -1) {
+            watch->wd = inotify_add_watch(watch->fd, watch->filename, WATCH_MASK);
+            changed |= watch->wd != -1;
+        }
+
+        return changed;
+    }
+#endif
+
+    struct stat st;
+    if (stat(watch->filename, &st) == -1)
+        return false;
+
+    changed = st.st_size != watch->st.st_size || st.st_mtime != watch->st.st_mtime
+        || st.st_ino != watch->st.st_ino;
+    watch->st = st;
+
+    return changed;
+}
+
+void watch_free(struct watch *watch) {
+    if (watch->fd != -1)
+        close(watch->fd);
+
+    free(watch->filename);
+    free(watch);
+}
@@ -0,0 +1,203 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils.h"
+#include "words.h"
+
+static void words_add(struct words *words, const char *word, size_t n_word, int delta);
+static void words_count_span(struct words *words, const char *chars, size_t n_chars, size_t from, size_t to,
+                             int delta);
+static void words_span(const char *chars, size_t n_chars, size_t *from, size_t *to);
+
+struct words *words_create(void) {
+    struct words *words = malloc(sizeof(struct words));
+
+    words->nodes_cap = 256;
+    words->nodes = malloc(sizeof(struct words_node) * words->nodes_cap);
+    words->nodes[0] = (struct words_node) { 0, 0, 0, 0, 0 };
+    words->n_nodes = 1;
+
+    return words;
+}
+
+// Bytes of UTF-8 sequences count too, so that words in any script complete
+bool words_is_char(char c) {
+    unsigned char u = c;
+    return (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9') || u == '_' || u >= 0x80;
+}
+
+// Adds, with delta 1, or takes away, with -1, every word in chars
+void words_count(struct words *words, const char *chars, size_t n_chars, int delta) {
+    words_count_span(words, chars, n_chars, 0, n_chars, delta);
+}
+
+// Called before n_removed chars at at are deleted, or before chars are
+// inserted there with n_removed 0. Takes away the words the edit touches.
+void words_edit_begin(struct words *words, const char *chars, size_t n_chars, size_t at, size_t n_removed) {
+    size_t from = at, to = at + n_removed;
+    words_span(chars, n_chars, &from, &to);
+
+    words_count_span(words, chars, n_chars, from, to, -1);
+}
+
+// Called after n_inserted chars were put at at, or after chars were deleted
+// there with n_inserted 0. Adds the words the edit left.
+void words_edit_end(struct words *words, const char *chars, size_t n_chars, size_t at, size_t n_inserted) {
+    size_t from = at, to = at + n_inserted;
+    words_span(chars, n_chars, &from, &to);
+
+    words_count_span(words, chars, n_chars, from, to, 1);
+}
+
+// Adds the words counted in src to dst, or with sign -1 takes them away
+void words_merge(struct words *dst, const struct words *src, int sign) {
+    char word[WORDS_MAX_LEN];
+
+    // Depth-first, with stack[depth] the node whose char is word[depth]
+    int stack[WORDS_MAX_LEN + 1];
+    int depth = 0;
+    stack[0] = src->nodes[0].child;
+
+    while (depth >= 0) {
+        int node = stack[depth];
+        if (node == 0) {
+            if (--depth >= 0)
+                stack[depth] = src->nodes[stack[depth]].next;
+            continue;
+        }
+
+        const struct words_node *n = &src->nodes[node];
+        word[depth] = n->c;
+
+        if (n->n_here)
+            words_add(dst, word, depth + 1, sign * (int) n->n_here);
+
+        if (n->n_below > n->n_here && n->child) stack[++depth] = n->child;
+        else stack[depth] = n->next;
+    }
+}
+
+// Writes the skip-th word, in byte order, that starts with prefix and is
+// longer than it into match, which must hold WORDS_MAX_LEN bytes. Returns the
+// word's length, or -1 if there are no more.
+int words_complete(const struct words *words, const char *prefix, size_t n_prefix, int skip, char *match) {
+    if (n_prefix >= WORDS_MAX_LEN)
+        return -1;
+
+    int node = 0;
+    for (size_t i = 0; i < n_prefix; i++) {
+        node = words->nodes[node].child;
+        while (node && words->nodes[node].c != (unsigned char) prefix[i])
+            node = words->nodes[node].next;
+
+        if (node == 0 || words->nodes[node].n_below == 0)
+            return -1;
+    }
+
+    memcpy(match, prefix, n_prefix);
+
+    // As in words_merge, but below the prefix and skipping dead branches
+    int stack[WORDS_MAX_LEN + 1];
+    int depth = n_prefix;
+    stack[depth] = words->nodes[node].child;
+
+    while (depth >= (int) n_prefix) {
+        node = stack[depth];
+        if (node == 0) {
+            if (--depth >= (int) n_prefix)
+                stack[depth] = words->nodes[stack[depth]].next;
+            continue;
+        }
+
+        const struct words_node *n = &words->nodes[node];
+        if (n->n_below == 0) {
+            stack[depth] = n->next;
+            continue;
+        }
+
+        match[depth] = n->c;
+
+        if (n->n_here && skip-- == 0)
+            return depth + 1;
+
+        if (n->n_below > n->n_here && n->child) stack[++depth] = n->child;
+        else stack[depth] = n->next;
+    }
+
+    return -1;
+}
+
+void words_free(struct words *words) {
+    free(words->nodes);
+    free(words);
+}
+
+/*****************************************************************************/
+
+static int words_node_create(struct words *words, unsigned char c, int next) {
+    if (words->n_nodes == words->nodes_cap) {
+        words->nodes_cap *= 2;
+        words->nodes = realloc(words->nodes, sizeof(struct words_node) * words->nodes_cap);
+    }
+
+    words->nodes[words->n_nodes] = (struct words_node) { 0, next, c, 0, 0 };
+    return words->n_nodes++;
+}
+
+static void words_add(struct words *words, const char *word, size_t n_word, int delta) {
+    int node = 0;
+    words->nodes[0].n_below += delta;
+
+    for (size_t i = 0; i < n_word; i++) {
+        unsigned char c = word[i];
+
+        // link is where the child for c is, or would go to keep the order
+        int *link = &words->nodes[node].child;
+        while (*link && words->nodes[*link].c < c)
+            link = &words->nodes[*link].next;
+
+        if (*link == 0 || words->nodes[*link].c != c) {
+            // Creating the node may move the array link points into
+            ptrdiff_t offset = (char *) link - (char *) words->nodes;
+            int created = words_node_create(words, c, *link);
+
+            link = (int *) ((char *) words->nodes + offset);
+            *link = created;
+        }
+
+        node = *link;
+        words->nodes[node].n_below += delta;
+    }
+
+    words->nodes[node].n_here += delta;
+}
+
+static void words_count_span(struct words *words, const char *chars, size_t n_chars, size_t from, size_t to,
+                             int delta) {
+    size_t i = from;
+
+    while (i < to) {
+        while (i < to && !words_is_char(chars[i]))
+            i++;
+
+        size_t start = i;
+        while (i < n_chars && words_is_char(chars[i]))
+            i++;
+
+        // Numbers are rarely worth completing and would crowd the trie
+        size_t n_word = i - start;
+        bool number = n_word && chars[start] >= '0' && chars[start] <= '9';
+        if (n_word >= WORDS_MIN_LEN && n_word <= WORDS_MAX_LEN && !number)
+            words_add(words, chars + start, n_word, delta);
+    }
+}
+
+// Widens from..to to take in any word it cuts through
+static void words_span(const char *chars, size_t n_chars, size_t *from, size_t *to) {
+    while (*from > 0 && words_is_char(chars[*from - 1]))
+        (*from)--;
+
+    while (*to < n_chars && words_is_char(chars[*to]))
+        (*to)++;
+}